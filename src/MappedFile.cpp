@@ -0,0 +1,138 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+/*
+ * Open
+ *
+ * Maps the complete file read-only into the address space. Empty files
+ * cannot be mapped and are reported as failure.
+ */
+bool MappedFile::Open(const std::string& filepath) {
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        std::cerr << "Could not map empty file: " << filepath << std::endl;
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        std::cerr << "Could not create file mapping: " << filepath << std::endl;
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        std::cerr << "Could not map view of file: " << filepath << std::endl;
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_fileHandle = file;
+    m_mappingHandle = mapping;
+    m_data = static_cast<const char*>(view);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        std::cerr << "Could not map empty file: " << filepath << std::endl;
+        close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        std::cerr << "Could not map file: " << filepath << std::endl;
+        close(fd);
+        return false;
+    }
+    madvise(view, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+
+    m_fileDescriptor = fd;
+    m_data = static_cast<const char*>(view);
+    m_size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+    return true;
+}
+
+/*
+ * Discard
+ *
+ * Lets the OS drop already processed pages of a read-only mapping, which keeps the
+ * resident size bounded when streaming through files larger than RAM. The range is
+ * widened to page boundaries; a dropped page that is touched again is simply read
+ * back from the file. On Windows the working set manager trims clean file pages by
+ * itself, so this is a no-op there.
+ */
+void MappedFile::Discard(size_t offset, size_t length) {
+#ifndef _WIN32
+    if (m_data == nullptr || offset >= m_size) {
+        return;
+    }
+
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t first = offset / pageSize * pageSize;
+    size_t last = std::min(offset + length, m_size) / pageSize * pageSize;
+    if (last > first) {
+        madvise(const_cast<char*>(m_data) + first, last - first, MADV_DONTNEED);
+    }
+#else
+    (void)offset;
+    (void)length;
+#endif
+}
+
+void MappedFile::Close() {
+    if (m_data == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(static_cast<HANDLE>(m_mappingHandle));
+    CloseHandle(static_cast<HANDLE>(m_fileHandle));
+    m_mappingHandle = nullptr;
+    m_fileHandle = nullptr;
+#else
+    munmap(const_cast<char*>(m_data), m_size);
+    close(m_fileDescriptor);
+    m_fileDescriptor = -1;
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+}
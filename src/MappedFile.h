@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/*
+ * MappedFile
+ *
+ * Read-only memory mapping of a whole file. The mapping stays valid until
+ * Close() is called or the object is destroyed, so decoders can read directly
+ * from Data() without copying the file into a stream buffer first.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& filepath);
+    void Close();
+
+    // hint that [offset, offset + length) is not needed anymore, the pages may be dropped
+    void Discard(size_t offset, size_t length);
+
+    bool IsOpen() const { return m_data != nullptr; }
+    const char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+
+#ifdef _WIN32
+    void* m_fileHandle = nullptr;
+    void* m_mappingHandle = nullptr;
+#else
+    int m_fileDescriptor = -1;
+#endif
+};
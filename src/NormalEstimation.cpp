@@ -0,0 +1,160 @@
+#include "NormalEstimation.h"
+#include "Parallel.h"
+#include "PointGrid.h"
+#include "SymmetricEigen.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+    const size_t NORMAL_MIN_CHUNK = 4096;
+    const size_t NORMAL_BLOCK = 1024;   // points per covariance batch of one thread
+    const float LINE_RATIO = 1e-6f;     // middle / largest eigenvalue below this: the neighbourhood is a line
+}
+
+/*
+ * EstimateNormalsPCA
+ *
+ * The neighbourhood of a point is the point and its k nearest neighbours.
+ * Every thread collects the covariances of NORMAL_BLOCK points and solves
+ * them together with SymmetricEigen::Solve.
+ */
+NormalEstimationStats EstimateNormalsPCA(PointCloud& cloud, const PCANormalOptions& options) {
+    NormalEstimationStats stats;
+    auto begin = std::chrono::steady_clock::now();
+
+    const size_t count = cloud.Size();
+    const size_t k = static_cast<size_t>(std::max(options.neighbours, 2));
+    stats.points = count;
+    if (count == 0) {
+        return stats;
+    }
+
+    cloud.ComputeBounds();
+    PointGrid grid;
+    grid.BuildForDensity(cloud, float(k));
+    stats.gridMilliseconds = MillisecondsSince(begin);
+
+    const glm::vec3 center = 0.5f * (cloud.m_boundsMin + cloud.m_boundsMax);
+    const size_t chunks = ChunkCount(count, NORMAL_MIN_CHUNK);
+    std::vector<size_t> chunkDegenerate(chunks, 0);
+
+    ParallelFor(count, NORMAL_MIN_CHUNK, [&](size_t first, size_t last, size_t chunk) {
+        std::vector<PointGrid::Neighbour> neighbours;
+        std::vector<uint32_t> indices;
+        std::vector<uint32_t> found(NORMAL_BLOCK);
+        SymmetricEigen::SymmetricMatrices matrices;
+        SymmetricEigen::SmallestEigen eigen;
+        neighbours.reserve(k);
+        indices.reserve(k);
+
+        for (size_t blockFirst = first; blockFirst < last; blockFirst += NORMAL_BLOCK) {
+            size_t blockSize = std::min(NORMAL_BLOCK, last - blockFirst);
+            matrices.Resize(blockSize);
+            for (size_t b = 0; b < blockSize; b++) {
+                uint32_t i = static_cast<uint32_t>(blockFirst + b);
+                found[b] = static_cast<uint32_t>(grid.KNearest(cloud.m_positions[i], k, i, neighbours));
+                indices.clear();
+                for (const PointGrid::Neighbour& neighbour : neighbours) indices.push_back(neighbour.second);
+                SymmetricEigen::NeighbourhoodCovariance(cloud.m_positions.data(), i, indices.data(), indices.size(), matrices, b);
+            }
+
+            SymmetricEigen::Solve(matrices, eigen);
+
+            for (size_t b = 0; b < blockSize; b++) {
+                size_t i = blockFirst + b;
+                glm::vec3 normal(eigen.x[b], eigen.y[b], eigen.z[b]);
+                if (found[b] < 2 || !(eigen.value2[b] > 0.0f)) {
+                    // no neighbours or all of them on the same spot
+                    normal = glm::vec3(0.0f);
+                    chunkDegenerate[chunk]++;
+                }
+                else if (eigen.value1[b] <= LINE_RATIO * eigen.value2[b]) {
+                    // any perpendicular of the line, the solver returns one
+                    chunkDegenerate[chunk]++;
+                }
+
+                const glm::vec3 position = cloud.m_positions[i];
+                glm::vec3 facing = options.towardViewpoint ? options.viewpoint - position : position - center;
+                if (glm::dot(normal, facing) < 0.0f) {
+                    normal = -normal;
+                }
+                cloud.m_normals[i] = normal;
+            }
+        }
+    });
+
+    for (size_t degenerate : chunkDegenerate) stats.degenerate += degenerate;
+    cloud.m_hasNormals = true;
+
+    stats.milliseconds = MillisecondsSince(begin);
+    std::cout << "PCA normals (k = " << k << "): " << count << " points in " << stats.milliseconds << " ms (grid "
+        << stats.gridMilliseconds << " ms, " << double(count) / (stats.milliseconds * 1000.0) << " M points/s on "
+        << WorkerCount() << " threads, " << SymmetricEigen::InstructionSet() << "), " << stats.degenerate << " degenerate" << std::endl;
+    return stats;
+}
+
+float NormalErrorAngle(const glm::vec3& normal, const glm::vec3& normalGT) {
+    float d = glm::clamp(glm::dot(normal, normalGT), -1.0f, 1.0f);
+    return glm::degrees(std::acos(d));
+}
+
+NormalErrorClass ClassifyNormalError(float degrees) {
+    if (degrees >= 0.01f && degrees <= 5.0f) return NormalErrorClass::Within5;
+    if (degrees >= 0.01f && degrees <= 30.0f) return NormalErrorClass::Within30;
+    if (degrees > 30.0f && degrees <= 180.0f) return NormalErrorClass::Above30;
+    return NormalErrorClass::Invalid;
+}
+
+glm::vec3 NormalErrorColor(NormalErrorClass errorClass) {
+    switch (errorClass) {
+    case NormalErrorClass::Within5: return glm::vec3(0.0f, 1.0f, 0.0f);
+    case NormalErrorClass::Within30: return glm::vec3(1.0f, 1.0f, 0.0f);
+    case NormalErrorClass::Above30: return glm::vec3(1.0f, 0.0f, 0.0f);
+    default: return glm::vec3(0.0f);
+    }
+}
+
+NormalErrorStats CompareNormals(PointCloud& cloud, const PointCloud& groundTruth) {
+    NormalErrorStats stats;
+    const size_t count = cloud.Size();
+    PointVector<glm::vec4> normalsGT = groundTruth.PackNormalsByID(cloud.m_ids.data(), count);
+
+    const size_t chunks = ChunkCount(count, NORMAL_MIN_CHUNK);
+    std::vector<NormalErrorStats> chunkStats(chunks);
+    std::vector<double> chunkAngles(chunks, 0.0);
+    std::vector<size_t> chunkCompared(chunks, 0);
+    ParallelFor(count, NORMAL_MIN_CHUNK, [&](size_t first, size_t last, size_t chunk) {
+        NormalErrorStats& local = chunkStats[chunk];
+        for (size_t i = first; i < last; i++) {
+            glm::vec3 normalGT = glm::vec3(normalsGT[i]);
+            float theta = NormalErrorAngle(cloud.m_normals[i], normalGT);
+            bool compared = glm::dot(normalGT, normalGT) > 0.0f;
+
+            NormalErrorClass errorClass = ClassifyNormalError(theta);
+            cloud.m_colors[i] = NormalErrorColor(errorClass);
+            if (compared) {
+                if (errorClass == NormalErrorClass::Within5) local.within5++;
+                else if (errorClass == NormalErrorClass::Within30) local.within30++;
+                else if (errorClass == NormalErrorClass::Above30) local.above30++;
+                chunkAngles[chunk] += theta;
+                chunkCompared[chunk]++;
+            }
+        }
+    });
+
+    double angles = 0.0;
+    size_t compared = 0;
+    for (size_t c = 0; c < chunks; c++) {
+        stats.within5 += chunkStats[c].within5;
+        stats.within30 += chunkStats[c].within30;
+        stats.above30 += chunkStats[c].above30;
+        angles += chunkAngles[c];
+        compared += chunkCompared[c];
+    }
+    stats.meanAngle = compared > 0 ? static_cast<float>(angles / double(compared)) : 0.0f;
+    return stats;
+}
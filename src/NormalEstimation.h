@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+
+#include "PointCloud.h"
+
+struct PCANormalOptions {
+    int neighbours = 16;                        // k nearest neighbours per plane fit, the point itself is added
+    bool towardViewpoint = false;               // false: orient away from the center of the cloud bounds
+    glm::vec3 viewpoint = glm::vec3(0.0f);      // scanner or camera position if towardViewpoint
+};
+
+struct NormalEstimationStats {
+    size_t points = 0;
+    size_t degenerate = 0;          // neighbourhood without a unique plane (line, single spot), see EstimateNormalsPCA
+    double gridMilliseconds = 0.0;
+    double milliseconds = 0.0;      // total, including the grid
+};
+
+// counts and mean angle only include points with a ground truth normal
+struct NormalErrorStats {
+    size_t within5 = 0;             // green in average_normal.comp
+    size_t within30 = 0;            // yellow
+    size_t above30 = 0;             // red
+    float meanAngle = 0.0f;         // degrees
+};
+
+// color classes of average_normal.comp
+enum class NormalErrorClass {
+    Within5,        // green
+    Within30,       // yellow
+    Above30,        // red
+    Invalid         // black: angle below 0.01 degrees or NaN
+};
+
+// angle between normal and ground truth in degrees, clamped like in the shader
+float NormalErrorAngle(const glm::vec3& normal, const glm::vec3& normalGT);
+NormalErrorClass ClassifyNormalError(float degrees);
+glm::vec3 NormalErrorColor(NormalErrorClass errorClass);
+
+/*
+ * EstimateNormalsPCA
+ *
+ * CPU normal estimation without any GL context: a PointGrid over the
+ * positions, a k-nearest-neighbour query per point and the eigenvector of
+ * the smallest eigenvalue of the neighbourhood covariance as normal, in
+ * parallel over all points. Normals are written to cloud.m_normals and
+ * m_hasNormals is set, so SavePLY and the ground truth comparison take them
+ * like the ones read back from the GPU.
+ *
+ * Neighbourhoods spanning only a line get some normal perpendicular to it,
+ * coincident points a zero normal; both count as degenerate.
+ */
+NormalEstimationStats EstimateNormalsPCA(PointCloud& cloud, const PCANormalOptions& options = PCANormalOptions());
+
+/*
+ * CompareNormals
+ *
+ * CPU version of the comparison in average_normal.comp: angle between every
+ * normal and the ground truth normal with the same ID, points are colored
+ * with the same thresholds.
+ */
+NormalErrorStats CompareNormals(PointCloud& cloud, const PointCloud& groundTruth);
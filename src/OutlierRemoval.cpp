@@ -0,0 +1,85 @@
+#include "OutlierRemoval.h"
+#include "Parallel.h"
+#include "PointGrid.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+OutlierStats RemoveStatisticalOutliers(PointCloud& cloud, const OutlierOptions& options) {
+    OutlierStats stats;
+    auto begin = std::chrono::steady_clock::now();
+
+    const size_t count = cloud.Size();
+    const size_t k = static_cast<size_t>(std::max(options.neighbours, 1));
+    if (count <= k) {
+        return stats;
+    }
+
+    cloud.ComputeBounds();
+    PointGrid grid;
+    grid.BuildForDensity(cloud, float(k));
+
+    // mean neighbour distance per point, infinity if a point has no neighbour in range
+    std::vector<float> meanDistance(count);
+    const size_t chunks = ChunkCount(count, 4096);
+    std::vector<double> chunkSum(chunks, 0.0);
+    std::vector<double> chunkSquares(chunks, 0.0);
+    std::vector<size_t> chunkValid(chunks, 0);
+
+    ParallelFor(count, 4096, [&](size_t first, size_t last, size_t chunk) {
+        std::vector<PointGrid::Neighbour> neighbours;
+        neighbours.reserve(k);
+        for (size_t i = first; i < last; i++) {
+            size_t found = grid.KNearest(cloud.m_positions[i], k, static_cast<uint32_t>(i), neighbours);
+            if (found == 0) {
+                meanDistance[i] = std::numeric_limits<float>::infinity();
+                continue;
+            }
+
+            float sum = 0.0f;
+            for (const PointGrid::Neighbour& neighbour : neighbours) sum += std::sqrt(neighbour.first);
+            meanDistance[i] = sum / float(found);
+
+            chunkSum[chunk] += meanDistance[i];
+            chunkSquares[chunk] += double(meanDistance[i]) * meanDistance[i];
+            chunkValid[chunk]++;
+        }
+    });
+
+    double sum = 0.0, squares = 0.0;
+    size_t valid = 0;
+    for (size_t c = 0; c < chunks; c++) {
+        sum += chunkSum[c];
+        squares += chunkSquares[c];
+        valid += chunkValid[c];
+    }
+    double mean = valid > 0 ? sum / double(valid) : 0.0;
+    double variance = valid > 1 ? std::max(0.0, (squares - sum * mean) / double(valid - 1)) : 0.0;
+    stats.meanDistance = static_cast<float>(mean);
+    stats.threshold = static_cast<float>(mean + options.stdDevMultiplier * std::sqrt(variance));
+
+    std::vector<uint8_t> keep(count);
+    for (size_t i = 0; i < count; i++) {
+        keep[i] = meanDistance[i] <= stats.threshold ? 1 : 0;
+        if (!keep[i]) stats.outliers++;
+    }
+
+    if (options.remove) {
+        cloud.Filter(keep);
+        cloud.ComputeBounds();
+    }
+    else {
+        PointVector<float>& flags = cloud.AddChannel("outlier", 1).values;
+        for (size_t i = 0; i < count; i++) {
+            flags[i] = keep[i] ? 0.0f : 1.0f;
+        }
+    }
+
+    stats.milliseconds = MillisecondsSince(begin);
+    std::cout << "Outlier removal (k = " << k << ", " << options.stdDevMultiplier << " sigma): "
+        << stats.outliers << " of " << count << (options.remove ? " points removed" : " points flagged")
+        << " in " << stats.milliseconds << " ms" << std::endl;
+    return stats;
+}
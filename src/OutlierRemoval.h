@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+#include "PointCloud.h"
+
+struct OutlierOptions {
+    int neighbours = 16;            // k of the mean k-nearest-neighbour distance
+    float stdDevMultiplier = 2.0f;  // outlier if mean distance > global mean + multiplier * standard deviation
+    bool remove = true;             // false: keep all points and mark outliers in the "outlier" channel (1 = outlier)
+};
+
+struct OutlierStats {
+    size_t outliers = 0;
+    float meanDistance = 0.0f;
+    float threshold = 0.0f;
+    double milliseconds = 0.0;
+};
+
+/*
+ * RemoveStatisticalOutliers
+ *
+ * Statistical outlier removal for scanner noise: every point gets the mean
+ * distance to its k nearest neighbours (PointGrid queries, parallel over all
+ * points), points far above the distribution of these distances are removed or
+ * flagged. Points without any neighbour within the search range count as
+ * outliers. Prints and returns how many points were affected and how long it took.
+ */
+OutlierStats RemoveStatisticalOutliers(PointCloud& cloud, const OutlierOptions& options = OutlierOptions());
@@ -1,75 +1,357 @@
 #include "PLY_loader.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+    PlyType ParsePlyType(const std::string& name) {
+        if (name == "char" || name == "int8") return PlyType::Char;
+        if (name == "uchar" || name == "uint8") return PlyType::UChar;
+        if (name == "short" || name == "int16") return PlyType::Short;
+        if (name == "ushort" || name == "uint16") return PlyType::UShort;
+        if (name == "int" || name == "int32") return PlyType::Int;
+        if (name == "uint" || name == "uint32") return PlyType::UInt;
+        if (name == "float" || name == "float32") return PlyType::Float;
+        if (name == "double" || name == "float64") return PlyType::Double;
+        return PlyType::Invalid;
+    }
+
+    template <typename T>
+    T LoadScalar(const char* src, bool swapBytes) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, src, sizeof(T));
+        if (swapBytes) {
+            std::reverse(bytes, bytes + sizeof(T));
+        }
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+    // reads one binary value of the given type and converts it to double
+    double ReadBinaryValue(const char* src, PlyType type, bool swapBytes) {
+        switch (type) {
+        case PlyType::Char:   return LoadScalar<int8_t>(src, false);
+        case PlyType::UChar:  return LoadScalar<uint8_t>(src, false);
+        case PlyType::Short:  return LoadScalar<int16_t>(src, swapBytes);
+        case PlyType::UShort: return LoadScalar<uint16_t>(src, swapBytes);
+        case PlyType::Int:    return LoadScalar<int32_t>(src, swapBytes);
+        case PlyType::UInt:   return LoadScalar<uint32_t>(src, swapBytes);
+        case PlyType::Float:  return LoadScalar<float>(src, swapBytes);
+        case PlyType::Double: return LoadScalar<double>(src, swapBytes);
+        default:              return 0.0;
+        }
+    }
+
+    /*
+     * Walks over one element with list properties and returns the pointer behind it.
+     * Returns nullptr if the element would run past the end of the data.
+     */
+    const char* SkipVariableElement(const char* cursor, const char* end, const PlyElement& element, bool swapBytes) {
+        for (const PlyProperty& prop : element.properties) {
+            if (prop.isList) {
+                size_t countSize = PlyTypeSize(prop.countType);
+                if (cursor + countSize > end) return nullptr;
+                size_t entries = static_cast<size_t>(ReadBinaryValue(cursor, prop.countType, swapBytes));
+                cursor += countSize + entries * PlyTypeSize(prop.type);
+            }
+            else {
+                cursor += PlyTypeSize(prop.type);
+            }
+            if (cursor > end) return nullptr;
+        }
+        return cursor;
+    }
+
+    // commas separate values in xyz/csv exports, they never appear in valid PLY bodies
+    bool IsBlank(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == ',';
+    }
+
+    // empty, whitespace only and # comment lines, xyz files may contain them between the points
+    bool IsSkippedLine(const char* p, const char* lineEnd) {
+        while (p < lineEnd && IsBlank(*p)) p++;
+        return p == lineEnd || *p == '#';
+    }
+
+    /*
+     * Parses one ASCII vertex line into values (one float per property, in schema order).
+     * List properties are consumed and ignored. The slot of a packed color (packedIndex)
+     * receives the raw 32 bits instead, integer colors above 2^24 would lose bits as float.
+     * Returns false if a token is malformed or missing.
+     */
+    bool ParseAsciiVertex(const char* p, const char* lineEnd, const std::vector<PlyProperty>& props, float* values,
+        int packedIndex = -1) {
+        for (size_t i = 0; i < props.size(); i++) {
+            while (p < lineEnd && IsBlank(*p)) p++;
+
+            if (props[i].isList) {
+                size_t entries = 0;
+                auto result = std::from_chars(p, lineEnd, entries);
+                if (result.ec != std::errc()) return false;
+                p = result.ptr;
+                for (size_t e = 0; e < entries; e++) {
+                    while (p < lineEnd && IsBlank(*p)) p++;
+                    while (p < lineEnd && !IsBlank(*p)) p++;
+                }
+                continue;
+            }
+
+            if (p < lineEnd && *p == '+') p++;
+            if (static_cast<int>(i) == packedIndex && props[i].type != PlyType::Float) {
+                uint32_t bits = 0;
+                auto result = std::from_chars(p, lineEnd, bits);
+                if (result.ec != std::errc()) return false;
+                std::memcpy(&values[i], &bits, sizeof(bits));
+                p = result.ptr;
+                continue;
+            }
+            auto result = std::from_chars(p, lineEnd, values[i]);
+            if (result.ec != std::errc()) return false;
+            p = result.ptr;
+        }
+        return true;
+    }
+
+    /*
+     * Checks whether the vertex element matches one of the layouts PLY_decoders.h has
+     * specialized kernels for: fixed size, float xyz (and nx ny nz) stored back to back,
+     * optional uchar red green blue stored back to back.
+     */
+    bool DetectFastLayout(const PlyElement& vertex, const PlyVertexLayout& layout, PlyFastLayout& fast) {
+        const std::vector<PlyProperty>& props = vertex.properties;
+
+        auto isTriple = [&](int a, int b, int c, PlyType type) {
+            size_t size = PlyTypeSize(type);
+            return props[a].type == type && props[b].type == type && props[c].type == type
+                && props[b].offset == props[a].offset + size && props[c].offset == props[b].offset + size;
+        };
+
+        if (vertex.stride == 0 || layout.x < 0 || layout.y < 0 || layout.z < 0 || layout.rgb >= 0) return false;
+        if (!isTriple(layout.x, layout.y, layout.z, PlyType::Float)) return false;
+
+        bool anyNormal = layout.nx >= 0 || layout.ny >= 0 || layout.nz >= 0;
+        if (anyNormal && !(layout.HasNormals() && isTriple(layout.nx, layout.ny, layout.nz, PlyType::Float))) return false;
+
+        bool anyColor = layout.red >= 0 || layout.green >= 0 || layout.blue >= 0;
+        bool allColor = layout.red >= 0 && layout.green >= 0 && layout.blue >= 0;
+        if (anyColor && !(allColor && isTriple(layout.red, layout.green, layout.blue, PlyType::UChar))) return false;
+
+        fast.stride = vertex.stride;
+        fast.positionOffset = props[layout.x].offset;
+        fast.normalOffset = anyNormal ? props[layout.nx].offset : 0;
+        fast.colorOffset = anyColor ? props[layout.red].offset : 0;
+        return true;
+    }
+
+    void DecodeFastLayout(const char* data, size_t count, const PlyFastLayout& fast, bool normals, bool colors,
+        int firstID, const PointArrays& out) {
+        if (normals && colors) PlyDecoders::DecodeVertices<true, true>(data, count, fast, firstID, out);
+        else if (normals) PlyDecoders::DecodeVertices<true, false>(data, count, fast, firstID, out);
+        else if (colors) PlyDecoders::DecodeVertices<false, true>(data, count, fast, firstID, out);
+        else PlyDecoders::DecodeVertices<false, false>(data, count, fast, firstID, out);
+    }
+
+    // integer colors are 0..255, float colors are already normalized
+    float ColorScale(PlyType type) {
+        return (type == PlyType::Float || type == PlyType::Double) ? 1.0f : 1.0f / 255.0f;
+    }
+
+    glm::vec3 UnpackColor(uint32_t rgb) {
+        return glm::vec3((rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff) * (1.0f / 255.0f);
+    }
+
+    glm::vec3 UnpackColor(float bits) {
+        uint32_t rgb;
+        std::memcpy(&rgb, &bits, sizeof(rgb));
+        return UnpackColor(rgb);
+    }
+}
+
+size_t PlyTypeSize(PlyType type) {
+    switch (type) {
+    case PlyType::Char:
+    case PlyType::UChar:  return 1;
+    case PlyType::Short:
+    case PlyType::UShort: return 2;
+    case PlyType::Int:
+    case PlyType::UInt:
+    case PlyType::Float:  return 4;
+    case PlyType::Double: return 8;
+    default:              return 0;
+    }
+}
+
+PlyVertexLayout::PlyVertexLayout(const PlyElement& vertex) {
+    x = vertex.FindProperty("x");
+    y = vertex.FindProperty("y");
+    z = vertex.FindProperty("z");
+    nx = vertex.FindProperty("nx");
+    ny = vertex.FindProperty("ny");
+    nz = vertex.FindProperty("nz");
+    red = vertex.FindProperty("red");
+    green = vertex.FindProperty("green");
+    blue = vertex.FindProperty("blue");
+
+    if (red < 0 && green < 0 && blue < 0) {
+        rgb = vertex.FindProperty("rgb");
+        if (rgb < 0) rgb = vertex.FindProperty("rgba");
+        if (rgb >= 0 && PlyTypeSize(vertex.properties[rgb].type) != 4) rgb = -1;
+    }
+}
+
+void ComputeElementLayout(PlyHeader& header) {
+    for (PlyElement& element : header.elements) {
+        size_t offset = 0;
+        bool fixedSize = true;
+        for (PlyProperty& prop : element.properties) {
+            prop.offset = offset;
+            if (prop.isList) fixedSize = false;
+            offset += PlyTypeSize(prop.type);
+        }
+        element.stride = fixedSize ? offset : 0;
+    }
+}
+
+int PlyElement::FindProperty(const std::string& propertyName) const {
+    for (size_t i = 0; i < properties.size(); ++i) {
+        if (properties[i].name == propertyName && !properties[i].isList)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
 
 /*
  * load_ply
  *
  * Parses a given PLY file and extracts its data into a PointCloud object.
  *
- * Open the file, parse the header and store encountered properties (x,y,z..). Check the format
- * and extract its content.
+ * Map the file into memory, parse the header into a typed schema (elements with their
+ * properties, offsets and stride) and decode the body straight from the mapping.
  *
  *
  */
 
 PointCloud PLY_loader::LoadPLY(const std::string& filepath) {
-    std::ifstream ply_file(filepath, std::ios::binary);
-    std::string ply_format = "";
-    std::vector<std::string> property_order;
-
-    int vertices = 0;
+    MappedFile file;
 
-    if (!ply_file.is_open()) {
+    if (!file.Open(filepath)) {
         std::cerr << "Could not open file: " << filepath << std::endl;
         return {};
     }
 
-    std::string line;
-    while (std::getline(ply_file, line)) {
+    return DecodePLY(file.Data(), file.Size(), filepath);
+}
+
+PointCloud PLY_loader::DecodePLY(const char* data, size_t size, const std::string& filepath) {
+    PlyHeader header;
+    if (!ParseHeader(data, size, header)) {
+        std::cerr << "Invalid PLY header: " << filepath << std::endl;
+        return {};
+    }
+
+    const char* body = data + header.dataOffset;
+    const char* end = data + size;
+
+    PointCloud cloud;
+    if (header.format == PlyFormat::Ascii) {
+        cloud = ExtractAsciiData(body, end, header);
+    }
+    else if (header.format == PlyFormat::BinaryLittleEndian || header.format == PlyFormat::BinaryBigEndian) {
+        cloud = ExtractBinaryData(body, end, header);
+    }
+    else {
+        std::cerr << "Unsupported PLY format in: " << filepath << std::endl;
+        return {};
+    }
+
+    cloud.ComputeBounds();
+    return cloud;
+}
+
+/*
+ * ParseHeader
+ *
+ * Reads the header lines up to "end_header" and builds the element/property schema.
+ * For every element without list properties the byte offset of each property and the
+ * stride of one element are computed here, so the binary decoder never has to look at
+ * property names again.
+ */
+bool PLY_loader::ParseHeader(const char* data, size_t size, PlyHeader& header) {
+    const char* cursor = data;
+    const char* end = data + size;
+    bool first = true;
+
+    while (cursor < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+        if (lineEnd == nullptr) lineEnd = end;
+
+        std::string line(cursor, lineEnd);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        cursor = (lineEnd < end) ? lineEnd + 1 : end;
+
         std::istringstream iss(line);
         std::string keyword;
         iss >> keyword;
 
+        if (first) {
+            if (keyword != "ply") return false;
+            first = false;
+            continue;
+        }
+
         if (keyword == "format") {
             std::string format;
             iss >> format;
-            ply_format = format;
+            if (format == "ascii") header.format = PlyFormat::Ascii;
+            else if (format == "binary_little_endian") header.format = PlyFormat::BinaryLittleEndian;
+            else if (format == "binary_big_endian") header.format = PlyFormat::BinaryBigEndian;
         }
-        if (keyword == "element") {
-            std::string element_type;
-            iss >> element_type;
-
-            if (element_type == "vertex") {
-                iss >> vertices;
-            }
+        else if (keyword == "element") {
+            PlyElement element;
+            iss >> element.name >> element.count;
+            header.elements.push_back(element);
         }
         else if (keyword == "property") {
-            std::string type, name;
-            iss >> type >> name;
+            if (header.elements.empty()) {
+                std::cerr << "PLY property outside of an element: " << line << std::endl;
+                return false;
+            }
+
+            PlyProperty prop;
+            std::string type;
+            iss >> type;
 
-            // Skip list types or malformed lines
             if (type == "list") {
-                std::string list_count_type, list_value_type, list_name;
-                iss >> list_count_type >> list_value_type >> list_name;
+                std::string countType, valueType;
+                iss >> countType >> valueType >> prop.name;
+                prop.isList = true;
+                prop.countType = ParsePlyType(countType);
+                prop.type = ParsePlyType(valueType);
             }
             else {
-                property_order.push_back(name);
+                iss >> prop.name;
+                prop.type = ParsePlyType(type);
             }
+
+            if (prop.type == PlyType::Invalid || (prop.isList && prop.countType == PlyType::Invalid)) {
+                std::cerr << "Unknown PLY property type: " << line << std::endl;
+                return false;
+            }
+            header.elements.back().properties.push_back(prop);
         }
         else if (keyword == "end_header") {
-            break;
+            header.dataOffset = static_cast<size_t>(cursor - data);
+            ComputeElementLayout(header);
+            return header.format != PlyFormat::Unknown;
         }
     }
 
-    if (ply_format == "ascii") {
-        return ExtractAsciiData(ply_file, property_order, vertices);
-    }
-    else if (ply_format == "binary_little_endian") {
-        return ExtractBinaryData(ply_file, property_order, vertices);
-    }
-    else {
-        std::cerr << "Unsupported PLY format: " << ply_format << std::endl;
-        return {};
-    }
+    return false;
 }
 
 /*
@@ -77,189 +359,611 @@ PointCloud PLY_loader::LoadPLY(const std::string& filepath) {
  *
  * Parses the content of an ASCII PLY file and fills a PointCloud object
  *
- *  - Iterates over each line (i.e., each point) and reads values based on property_order
- *  - Assigns a unique ID to each point
+ *  - Splits the body at newline boundaries into one chunk per worker
+ *  - Every worker counts the lines of its chunk, a prefix sum gives the global line
+ *    index each chunk starts at (elements before the vertices are skipped this way)
+ *  - Without a vertex count (xyz files) blank and # comment lines are not counted
+ *    in either pass, so they do not become points
+ *  - Every worker then parses its vertex lines with from_chars using the vertex schema
+ *    and writes them to their final slot, so IDs stay the line order of the file
  *  - Detects presence of normal attributes (nx, ny, nz) (no calculation for ply with normal data)
  *  - Assigns default color (255,255,255) if none provided
- *  - Adds the point to the cloud
  *
  */
-PointCloud PLY_loader::ExtractAsciiData(std::ifstream& ply_file,
-    const std::vector<std::string>& property_order,
-    int vertices) {
+PointCloud PLY_loader::ExtractAsciiData(const char* begin, const char* end, const PlyHeader& header) {
     PointCloud cloud;
-    int id_counter = 0;
-    std::string line;
-    bool has_nx = false, has_ny = false, has_nz = false;
 
-    std::cout << vertices << std::endl;
+    size_t firstVertexLine = 0;
+    const PlyElement* vertexElement = nullptr;
+    for (const PlyElement& element : header.elements) {
+        if (element.name == "vertex") {
+            vertexElement = &element;
+            break;
+        }
+        firstVertexLine += element.count;   // one line per element in ascii files
+    }
 
-    for (int i = 0; i < vertices && std::getline(ply_file, line); i++) {
-        std::istringstream iss(line);
-        Point point;
-        point.m_pointID = id_counter++;
-
-        int r = 255, g = 255, b = 255;  // fallback color
-
-        // Fill the point with properties of ply file
-        for (const std::string& prop : property_order) {
-            if (prop == "x")
-                iss >> point.m_position.x;
-            else if (prop == "y")
-                iss >> point.m_position.y;
-            else if (prop == "z")
-                iss >> point.m_position.z;
-            else if (prop == "nx") {
-                iss >> point.m_normal.x;
-                has_nx = true;
-            }
-            else if (prop == "ny") {
-                iss >> point.m_normal.y;
-                has_ny = true;
-            }
-            else if (prop == "nz") {
-                iss >> point.m_normal.z;
-                has_nz = true;
+    if (vertexElement == nullptr) {
+        std::cerr << "ASCII PLY without vertex element." << std::endl;
+        return cloud;
+    }
+
+    const PlyElement& element = *vertexElement;
+    const std::vector<PlyProperty>& props = element.properties;
+    PlyVertexLayout layout(element);
+
+    float colorScale[3] = {
+        layout.red >= 0 ? ColorScale(props[layout.red].type) : 0.0f,
+        layout.green >= 0 ? ColorScale(props[layout.green].type) : 0.0f,
+        layout.blue >= 0 ? ColorScale(props[layout.blue].type) : 0.0f
+    };
+
+    // split the body into byte ranges that start at the beginning of a line
+    const size_t minChunkBytes = 1 << 20;
+    size_t chunkCount = ChunkCount(static_cast<size_t>(end - begin), minChunkBytes);
+    std::vector<const char*> chunkStart(chunkCount + 1, end);
+    for (size_t c = 0; c < chunkCount; c++) {
+        const char* guess = begin + (end - begin) * c / chunkCount;
+        if (c > 0 && guess > begin && guess[-1] != '\n') {
+            const char* lineEnd = static_cast<const char*>(std::memchr(guess, '\n', end - guess));
+            guess = lineEnd ? lineEnd + 1 : end;
+        }
+        chunkStart[c] = std::max(guess, c > 0 ? chunkStart[c - 1] : begin);
+    }
+
+    // pass 1: count lines per chunk
+    const bool skipEmptyLines = element.count == PlyElement::UnknownCount;
+    std::vector<size_t> chunkLines(chunkCount + 1, 0);
+    ParallelFor(chunkCount, 1, [&](size_t first, size_t last, size_t) {
+        for (size_t c = first; c < last; c++) {
+            size_t lines = 0;
+            for (const char* p = chunkStart[c]; p < chunkStart[c + 1]; ) {
+                const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunkStart[c + 1] - p));
+                if (!skipEmptyLines || !IsSkippedLine(p, lineEnd ? lineEnd : chunkStart[c + 1])) lines++;
+                p = lineEnd ? lineEnd + 1 : chunkStart[c + 1];
             }
-            else if (prop == "red")
-                iss >> r;
-            else if (prop == "green")
-                iss >> g;
-            else if (prop == "blue")
-                iss >> b;
+            chunkLines[c + 1] = lines;
         }
+    });
+    for (size_t c = 0; c < chunkCount; c++) chunkLines[c + 1] += chunkLines[c];
 
-        cloud.m_hasNormals = has_nx && has_ny && has_nz;
+    size_t vertices = element.count;
+    size_t availableLines = chunkLines[chunkCount] > firstVertexLine ? chunkLines[chunkCount] - firstVertexLine : 0;
+    if (vertices == PlyElement::UnknownCount) {
+        vertices = availableLines;
+    }
+    else if (availableLines < vertices) {
+        std::cerr << "ASCII PLY truncated, only " << availableLines << " of " << vertices
+            << " vertices available." << std::endl;
+        vertices = availableLines;
+    }
+
+    cloud.Resize(vertices);
+    PointArrays out = cloud.Arrays();
+    std::vector<size_t> chunkErrors(chunkCount, 0);
+
+    // pass 2: parse the vertex lines of each chunk into their final slot
+    ParallelFor(chunkCount, 1, [&](size_t first, size_t last, size_t) {
+        std::vector<float> values(props.size());
+
+        for (size_t c = first; c < last; c++) {
+            size_t line = chunkLines[c];
+            const char* p = chunkStart[c];
+            const char* chunkEnd = chunkStart[c + 1];
+
+            while (p < chunkEnd && line < firstVertexLine + vertices) {
+                const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunkEnd - p));
+                if (lineEnd == nullptr) lineEnd = chunkEnd;
+
+                if (skipEmptyLines && IsSkippedLine(p, lineEnd)) {
+                    p = lineEnd + 1;
+                    continue;
+                }
+
+                if (line >= firstVertexLine) {
+                    std::fill(values.begin(), values.end(), 0.0f);
+                    if (!ParseAsciiVertex(p, lineEnd, props, values.data(), layout.rgb)) {
+                        chunkErrors[c]++;
+                    }
+
+                    size_t index = line - firstVertexLine;
+                    out.ids[index] = static_cast<int>(index);
+                    if (layout.x >= 0) out.positions[index].x = values[layout.x];
+                    if (layout.y >= 0) out.positions[index].y = values[layout.y];
+                    if (layout.z >= 0) out.positions[index].z = values[layout.z];
+                    if (layout.HasNormals()) {
+                        out.normals[index] = glm::vec3(values[layout.nx], values[layout.ny], values[layout.nz]);
+                    }
+
+                    // default color values
+                    out.colors[index] = layout.rgb >= 0 ? UnpackColor(values[layout.rgb]) : glm::vec3(
+                        layout.red >= 0 ? values[layout.red] * colorScale[0] : 1.0f,
+                        layout.green >= 0 ? values[layout.green] * colorScale[1] : 1.0f,
+                        layout.blue >= 0 ? values[layout.blue] * colorScale[2] : 1.0f);
+                }
+
+                line++;
+                p = lineEnd + 1;
+            }
+        }
+    });
 
-        // default color values
-        point.m_color = glm::vec3(r / 255.0f, g / 255.0f, b / 255.0f);
-        cloud.AddPoint(point);
+    size_t errors = 0;
+    for (size_t e : chunkErrors) errors += e;
+    if (errors > 0) {
+        std::cerr << errors << " malformed vertex lines in ASCII PLY." << std::endl;
     }
 
+    cloud.m_hasNormals = layout.HasNormals();
+
     std::cerr << "Loaded points: " << cloud.PointsAmount() << std::endl;
 
     return cloud;
 }
 
-PointCloud PLY_loader::ExtractBinaryData(std::ifstream& ply_file,
-    const std::vector<std::string>& property_order,
-    int vertices) {
+/*
+ * ExtractBinaryData
+ *
+ * Decodes the vertex element of a binary PLY directly from the mapped file.
+ * The actual decoding is done by PlyVertexReader, which is shared with the
+ * batched PLY_stream reader. Fixed size vertices are split into ranges that
+ * copies of the reader decode in parallel.
+ *
+ */
+PointCloud PLY_loader::ExtractBinaryData(const char* begin, const char* end, const PlyHeader& header) {
     PointCloud cloud;
-    int id_counter = 0;
-    bool has_nx = false, has_ny = false, has_nz = false;
-
-    while (ply_file.peek() != EOF) {
-        Point point;
-        point.m_pointID = id_counter++;
-        int r = 255, g = 255, b = 255;
-
-        for (const std::string& prop : property_order) {
-            if (prop == "x") {
-                float x;
-                ply_file.read(reinterpret_cast<char*>(&x), sizeof(float));
-                point.m_position.x = x;
-            }
-            else if (prop == "y") {
-                float y;
-                ply_file.read(reinterpret_cast<char*>(&y), sizeof(float));
-                point.m_position.y = y;
-            }
-            else if (prop == "z") {
-                float z;
-                ply_file.read(reinterpret_cast<char*>(&z), sizeof(float));
-                point.m_position.z = z;
-            }
-            else if (prop == "nx") {
-                float nx;
-                ply_file.read(reinterpret_cast<char*>(&nx), sizeof(float));
-                point.m_normal.x = nx;
-                has_nx = true;
-            }
-            else if (prop == "ny") {
-                float ny;
-                ply_file.read(reinterpret_cast<char*>(&ny), sizeof(float));
-                point.m_normal.y = ny;
-                has_ny = true;
-            }
-            else if (prop == "nz") {
-                float nz;
-                ply_file.read(reinterpret_cast<char*>(&nz), sizeof(float));
-                point.m_normal.z = nz;
-                has_nz = true;
-            }
-            else if (prop == "red") {
-                uint8_t c;
-                ply_file.read(reinterpret_cast<char*>(&c), 1);
-                r = c;
-            }
-            else if (prop == "green") {
-                uint8_t c;
-                ply_file.read(reinterpret_cast<char*>(&c), 1);
-                g = c;
+    PlyVertexReader reader;
+
+    if (!reader.Init(begin, end, header)) {
+        return cloud;
+    }
+
+    cloud.Resize(reader.Total());
+
+    if (reader.Seek(0)) {
+        ParallelFor(reader.Total(), 1 << 16, [&](size_t first, size_t last, size_t) {
+            PlyVertexReader range = reader;
+            range.Seek(first);
+            range.Read(cloud.Arrays(first), last - first);
+        });
+    }
+    else {
+        cloud.Resize(reader.Read(cloud.Arrays(), reader.Total()));
+    }
+    cloud.m_hasNormals = reader.HasNormals();
+
+    std::cerr << "Loaded (binary) points: " << cloud.PointsAmount() << std::endl;
+    return cloud;
+}
+
+/*
+ * PlyVertexReader::Init
+ *
+ * Locates the vertex element inside the body.
+ *
+ *  - Elements stored before the vertices are skipped by stride (or walked if they contain lists),
+ *    ascii elements are skipped by line
+ *  - The vertex count from the header is used, trailing elements (faces, edges) are never read
+ *  - Detects whether one of the fast layouts of PLY_decoders.h applies
+ *
+ */
+bool PlyVertexReader::Init(const char* body, const char* end, const PlyHeader& header) {
+    m_format = header.format;
+    m_swapBytes = header.format == PlyFormat::BinaryBigEndian;
+    m_cursor = body;
+    m_begin = body;
+    m_end = end;
+    m_next = 0;
+
+    const bool ascii = m_format == PlyFormat::Ascii;
+    const PlyElement* vertexElement = nullptr;
+
+    for (const PlyElement& element : header.elements) {
+        if (element.name == "vertex") {
+            vertexElement = &element;
+            break;
+        }
+
+        if (ascii) {
+            for (size_t i = 0; i < element.count && m_cursor < m_end; i++) {
+                const char* lineEnd = static_cast<const char*>(std::memchr(m_cursor, '\n', m_end - m_cursor));
+                m_cursor = lineEnd ? lineEnd + 1 : m_end;
             }
-            else if (prop == "blue") {
-                uint8_t c;
-                ply_file.read(reinterpret_cast<char*>(&c), 1);
-                b = c;
+        }
+        else if (element.stride > 0) {
+            m_cursor = (static_cast<size_t>(m_end - m_cursor) / element.stride < element.count)
+                ? nullptr : m_cursor + element.stride * element.count;
+        }
+        else {
+            for (size_t i = 0; i < element.count && m_cursor != nullptr; i++)
+                m_cursor = SkipVariableElement(m_cursor, m_end, element, m_swapBytes);
+        }
+
+        if (m_cursor == nullptr) {
+            std::cerr << "PLY truncated in element: " << element.name << std::endl;
+            return false;
+        }
+    }
+
+    if (vertexElement == nullptr) {
+        std::cerr << "PLY without vertex element." << std::endl;
+        return false;
+    }
+
+    m_vertex = *vertexElement;
+    m_vertexBegin = m_cursor;
+    m_layout = PlyVertexLayout(m_vertex);
+    m_total = m_vertex.count;
+
+    if (!ascii && m_vertex.stride > 0 && static_cast<size_t>(m_end - m_cursor) / m_vertex.stride < m_total) {
+        m_total = static_cast<size_t>(m_end - m_cursor) / m_vertex.stride;
+        std::cerr << "Binary PLY truncated, only " << m_total << " of " << m_vertex.count
+            << " vertices available." << std::endl;
+    }
+
+    const std::vector<PlyProperty>& props = m_vertex.properties;
+    m_colorScale[0] = m_layout.red >= 0 ? ColorScale(props[m_layout.red].type) : 0.0f;
+    m_colorScale[1] = m_layout.green >= 0 ? ColorScale(props[m_layout.green].type) : 0.0f;
+    m_colorScale[2] = m_layout.blue >= 0 ? ColorScale(props[m_layout.blue].type) : 0.0f;
+
+    m_offsets.resize(props.size());
+    for (size_t p = 0; p < props.size(); p++) m_offsets[p] = props[p].offset;
+    m_values.assign(props.size(), 0.0f);
+
+    // common layouts go to the specialized kernels, everything else takes the generic path
+    m_fast = !ascii && !m_swapBytes && DetectFastLayout(m_vertex, m_layout, m_fastLayout);
+
+    return true;
+}
+
+/*
+ * PlyVertexReader::Read
+ *
+ * Decodes up to maxPoints of the remaining vertices into out and returns how many
+ * were decoded. IDs continue where the previous call stopped.
+ */
+size_t PlyVertexReader::Read(const PointArrays& out, size_t maxPoints) {
+    size_t count = std::min(maxPoints, m_total - m_next);
+    if (count == 0) return 0;
+
+    size_t decoded = 0;
+    if (m_fast) {
+        DecodeFastLayout(m_cursor, count, m_fastLayout, m_layout.HasNormals(), m_layout.red >= 0,
+            static_cast<int>(m_next), out);
+        m_cursor += count * m_fastLayout.stride;
+        decoded = count;
+    }
+    else if (m_format == PlyFormat::Ascii) {
+        decoded = ReadAscii(out, count);
+    }
+    else {
+        decoded = ReadBinary(out, count);
+    }
+
+    m_next += decoded;
+    if (decoded < count) {
+        m_total = m_next;   // truncated file, nothing more to read
+    }
+    return decoded;
+}
+
+bool PlyVertexReader::Seek(size_t vertex) {
+    if (m_format == PlyFormat::Ascii || m_vertex.stride == 0 || vertex > m_total) {
+        return false;
+    }
+    m_cursor = m_vertexBegin + vertex * m_vertex.stride;
+    m_next = vertex;
+    return true;
+}
+
+/*
+ * Generic binary path: any scalar type, byte swapping and list properties inside
+ * the vertex element. Properties are read at their precomputed offsets, offsets are
+ * only recomputed per vertex if the element contains list properties.
+ */
+size_t PlyVertexReader::ReadBinary(const PointArrays& out, size_t count) {
+    const std::vector<PlyProperty>& props = m_vertex.properties;
+
+    auto read = [&](const char* base, int index) {
+        return static_cast<float>(ReadBinaryValue(base + m_offsets[index], props[index].type, m_swapBytes));
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        const char* base = m_cursor;
+
+        if (m_vertex.stride > 0) {
+            m_cursor += m_vertex.stride;
+        }
+        else {
+            size_t offset = 0;
+            bool truncated = false;
+            for (size_t p = 0; p < props.size() && !truncated; p++) {
+                m_offsets[p] = offset;
+                if (props[p].isList) {
+                    if (base + offset + PlyTypeSize(props[p].countType) > m_end) { truncated = true; break; }
+                    size_t entries = static_cast<size_t>(ReadBinaryValue(base + offset, props[p].countType, m_swapBytes));
+                    offset += PlyTypeSize(props[p].countType) + entries * PlyTypeSize(props[p].type);
+                }
+                else {
+                    offset += PlyTypeSize(props[p].type);
+                }
             }
-            else {
-                // Skip unknown property by type size if needed, or just ignore
-                std::cerr << "Unknown property in binary PLY: " << prop << std::endl;
+            if (truncated || static_cast<size_t>(m_end - base) < offset) {
+                std::cerr << "Binary PLY truncated at vertex " << m_next + i << std::endl;
+                return i;
             }
+            m_cursor = base + offset;
         }
 
-        point.m_color = glm::vec3(r / 255.0f, g / 255.0f, b / 255.0f);
-        cloud.AddPoint(point);
+        out.ids[i] = static_cast<int>(m_next + i);
+        out.positions[i] = glm::vec3(
+            m_layout.x >= 0 ? read(base, m_layout.x) : 0.0f,
+            m_layout.y >= 0 ? read(base, m_layout.y) : 0.0f,
+            m_layout.z >= 0 ? read(base, m_layout.z) : 0.0f);
+        out.normals[i] = m_layout.HasNormals()
+            ? glm::vec3(read(base, m_layout.nx), read(base, m_layout.ny), read(base, m_layout.nz)) : glm::vec3(0.0f);
+        out.colors[i] = m_layout.rgb >= 0
+            ? UnpackColor(LoadScalar<uint32_t>(base + m_offsets[m_layout.rgb], m_swapBytes)) : glm::vec3(
+            m_layout.red >= 0 ? read(base, m_layout.red) * m_colorScale[0] : 1.0f,
+            m_layout.green >= 0 ? read(base, m_layout.green) * m_colorScale[1] : 1.0f,
+            m_layout.blue >= 0 ? read(base, m_layout.blue) * m_colorScale[2] : 1.0f);
     }
+    return count;
+}
 
-    cloud.m_hasNormals = has_nx && has_ny && has_nz;
-    std::cerr << "Loaded (binary) points: " << cloud.PointsAmount() << std::endl;
-    return cloud;
+// sequential ascii path, the whole-file load uses the parallel ExtractAsciiData instead
+size_t PlyVertexReader::ReadAscii(const PointArrays& out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (m_cursor >= m_end) {
+            std::cerr << "ASCII PLY truncated at vertex " << m_next + i << std::endl;
+            return i;
+        }
+
+        const char* lineEnd = static_cast<const char*>(std::memchr(m_cursor, '\n', m_end - m_cursor));
+        if (lineEnd == nullptr) lineEnd = m_end;
+
+        std::fill(m_values.begin(), m_values.end(), 0.0f);
+        ParseAsciiVertex(m_cursor, lineEnd, m_vertex.properties, m_values.data(), m_layout.rgb);
+        m_cursor = lineEnd < m_end ? lineEnd + 1 : m_end;
+
+        out.ids[i] = static_cast<int>(m_next + i);
+        out.positions[i] = glm::vec3(
+            m_layout.x >= 0 ? m_values[m_layout.x] : 0.0f,
+            m_layout.y >= 0 ? m_values[m_layout.y] : 0.0f,
+            m_layout.z >= 0 ? m_values[m_layout.z] : 0.0f);
+        out.normals[i] = m_layout.HasNormals()
+            ? glm::vec3(m_values[m_layout.nx], m_values[m_layout.ny], m_values[m_layout.nz]) : glm::vec3(0.0f);
+        out.colors[i] = m_layout.rgb >= 0 ? UnpackColor(m_values[m_layout.rgb]) : glm::vec3(
+            m_layout.red >= 0 ? m_values[m_layout.red] * m_colorScale[0] : 1.0f,
+            m_layout.green >= 0 ? m_values[m_layout.green] * m_colorScale[1] : 1.0f,
+            m_layout.blue >= 0 ? m_values[m_layout.blue] * m_colorScale[2] : 1.0f);
+    }
+    return count;
 }
 
-void PLY_loader::SavePLY(std::string path, PointCloud pointCloud){
+namespace {
 
-    int pointsWritten = pointCloud.PointsAmount();
+    // points without a computed normal (never seen by any view) are zero or NaN
+    bool HasValidNormal(const glm::vec3& n) {
+        return !std::isnan(n.x) && !(n.x == 0 && n.y == 0 && n.z == 0);
+    }
 
-    for (int i = 0; i < pointCloud.PointsAmount(); ++i) {
-        auto point = pointCloud.GetPointByID(i)->GetPosition();
-        auto normal = pointCloud.GetNormalByID(i);
+    bool ShouldWrite(const glm::vec3& normal, const PlyWriteOptions& options) {
+        return !options.skipInvalidNormals || !(options.attributes & PlyAttributeNormal) || HasValidNormal(normal);
+    }
+
+    // positions relative to an origin are written as absolute double coordinates
+    bool HasOrigin(const PointCloudView& cloud) {
+        return cloud.m_origin != glm::dvec3(0.0);
+    }
 
-        if (std::isnan(normal.x) || (normal.x == 0 && normal.y == 0 && normal.z == 0)) {
-            pointsWritten--;
+    uint8_t ToColorByte(float value) {
+        return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    // points are written in blocks so the output buffer stays bounded for any cloud size
+    constexpr size_t WRITE_BLOCK_POINTS = 1 << 16;
+
+    // points of a spatially reordered cloud are written by original ID, so exports keep the
+    // order of the input file. Empty if the cloud already is in ID order
+    std::vector<uint32_t> ExportOrder(PointCloudView cloud) {
+        bool inOrder = true;
+        for (size_t i = 1; i < cloud.Size() && inOrder; i++) {
+            inOrder = cloud.m_ids[i - 1] <= cloud.m_ids[i];
+        }
+        if (inOrder) {
+            return {};
         }
 
+        std::vector<uint32_t> order(cloud.Size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = static_cast<uint32_t>(i);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return cloud.m_ids[a] < cloud.m_ids[b];
+        });
+        return order;
+    }
+}
+
+/*
+ * SavePLY
+ *
+ * Writes the point cloud with the selected attributes to path.
+ *
+ *  - Counts the points that will be written in a single pass (needed for the header)
+ *  - Points are written in original ID order, also for Morton sorted clouds
+ *  - binary_little_endian: positions/normals as float, colors as uchar, streamed in blocks
+ *  - Clouds with an origin (LAS) get it added back and write double positions, so the
+ *    file keeps the absolute coordinates of the source
+ *  - ascii: blocks are formatted in parallel with to_chars and written in order
+ *
+ */
+bool PLY_loader::SavePLY(const std::string& path, PointCloudView pointCloud, const PlyWriteOptions& options) {
+    if (options.format != PlyFormat::Ascii && options.format != PlyFormat::BinaryLittleEndian) {
+        std::cerr << "SavePLY only supports ascii and binary_little_endian." << std::endl;
+        return false;
+    }
+
+    size_t pointsWritten = 0;
+    for (size_t i = 0; i < pointCloud.Size(); i++) {
+        if (ShouldWrite(pointCloud.m_normals[i], options)) pointsWritten++;
+    }
+
+    std::cout << pointCloud.Size() - pointsWritten << " have been skipped.\n";
+
+    std::ofstream plyOutputFile(path, std::ios::binary);
+    if (!plyOutputFile.is_open()) {
+        std::cerr << "Could not open file for writing: " << path << std::endl;
+        return false;
     }
 
-    std::cout << pointCloud.PointsAmount() - pointsWritten << " have been skipped.\n";
-    
-    std::ofstream plyOutputFile;
-    plyOutputFile.open(path);
     plyOutputFile << "ply\n";
-    plyOutputFile << "format ascii 1.0\n";
-    plyOutputFile << "comment Created from SavePLY method \n";
-    plyOutputFile << "element vertex " << pointsWritten << " \n";
-    plyOutputFile << "property float x\n";
-    plyOutputFile << "property float y\n";
-    plyOutputFile << "property float z\n";
-    plyOutputFile << "property float nx\n";
-    plyOutputFile << "property float ny\n";
-    plyOutputFile << "property float nz\n";
-    plyOutputFile << "end_header \n";
-    
-
-    for (int i = 0; i < pointCloud.PointsAmount(); ++i){
-
-        auto point = pointCloud.GetPointByID(i)->GetPosition();
-        auto normal = pointCloud.GetNormalByID(i);
-
-        if (!std::isnan(normal.x) && !(normal.x == 0 && normal.y == 0 && normal.z == 0)) {
-            plyOutputFile << point.x << " " << point.y << " " << point.z << " "
-                << normal.x << " " << normal.y << " " << normal.z << "\n";
-            }
+    plyOutputFile << (options.format == PlyFormat::Ascii ? "format ascii 1.0\n" : "format binary_little_endian 1.0\n");
+    plyOutputFile << "comment Created from SavePLY method\n";
+    plyOutputFile << "element vertex " << pointsWritten << "\n";
+    if (options.attributes & PlyAttributePosition) {
+        const char* type = HasOrigin(pointCloud) ? "double" : "float";
+        plyOutputFile << "property " << type << " x\n";
+        plyOutputFile << "property " << type << " y\n";
+        plyOutputFile << "property " << type << " z\n";
+    }
+    if (options.attributes & PlyAttributeNormal) {
+        plyOutputFile << "property float nx\n";
+        plyOutputFile << "property float ny\n";
+        plyOutputFile << "property float nz\n";
     }
+    if (options.attributes & PlyAttributeColor) {
+        plyOutputFile << "property uchar red\n";
+        plyOutputFile << "property uchar green\n";
+        plyOutputFile << "property uchar blue\n";
+    }
+    plyOutputFile << "end_header\n";
 
+    std::vector<uint32_t> order = ExportOrder(pointCloud);
+    if (options.format == PlyFormat::Ascii) {
+        WriteAsciiBody(plyOutputFile, pointCloud, order, options);
+    }
+    else {
+        WriteBinaryBody(plyOutputFile, pointCloud, order, options);
+    }
 
-    plyOutputFile.close();
+    if (!plyOutputFile.good()) {
+        std::cerr << "Writing PLY failed: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
 
+void PLY_loader::WriteBinaryBody(std::ofstream& file, PointCloudView pointCloud, const std::vector<uint32_t>& order, const PlyWriteOptions& options) {
+    const bool absolute = HasOrigin(pointCloud);
+    size_t recordSize = 0;
+    if (options.attributes & PlyAttributePosition) recordSize += 3 * (absolute ? sizeof(double) : sizeof(float));
+    if (options.attributes & PlyAttributeNormal) recordSize += 3 * sizeof(float);
+    if (options.attributes & PlyAttributeColor) recordSize += 3;
+
+    std::vector<char> buffer(WRITE_BLOCK_POINTS * recordSize);
+    const size_t count = pointCloud.Size();
+
+    for (size_t blockBegin = 0; blockBegin < count; blockBegin += WRITE_BLOCK_POINTS) {
+        size_t blockEnd = std::min(count, blockBegin + WRITE_BLOCK_POINTS);
+        char* out = buffer.data();
+
+        for (size_t k = blockBegin; k < blockEnd; k++) {
+            size_t i = order.empty() ? k : order[k];
+            const glm::vec3& normal = pointCloud.m_normals[i];
+            if (!ShouldWrite(normal, options)) continue;
+
+            if (options.attributes & PlyAttributePosition) {
+                if (absolute) {
+                    glm::dvec3 position = glm::dvec3(pointCloud.m_positions[i]) + pointCloud.m_origin;
+                    std::memcpy(out, &position.x, 3 * sizeof(double));
+                    out += 3 * sizeof(double);
+                }
+                else {
+                    std::memcpy(out, &pointCloud.m_positions[i].x, 3 * sizeof(float));
+                    out += 3 * sizeof(float);
+                }
+            }
+            if (options.attributes & PlyAttributeNormal) {
+                std::memcpy(out, &normal.x, 3 * sizeof(float));
+                out += 3 * sizeof(float);
+            }
+            if (options.attributes & PlyAttributeColor) {
+                const glm::vec3& color = pointCloud.m_colors[i];
+                *out++ = static_cast<char>(ToColorByte(color.x));
+                *out++ = static_cast<char>(ToColorByte(color.y));
+                *out++ = static_cast<char>(ToColorByte(color.z));
+            }
+        }
+
+        file.write(buffer.data(), out - buffer.data());
+    }
+}
+
+void PLY_loader::WriteAsciiBody(std::ofstream& file, PointCloudView pointCloud, const std::vector<uint32_t>& order, const PlyWriteOptions& options) {
+    const size_t count = pointCloud.Size();
+    const size_t workers = WorkerCount();
+    const size_t superBlock = WRITE_BLOCK_POINTS * workers;
+    std::vector<std::string> chunkText(workers);
+
+    // 9 values of at most ~16 characters (~24 for double positions) plus separators
+    const size_t maxLine = 192;
+    const bool absolute = HasOrigin(pointCloud);
+
+    for (size_t blockBegin = 0; blockBegin < count; blockBegin += superBlock) {
+        size_t blockCount = std::min(superBlock, count - blockBegin);
+
+        size_t chunks = ParallelFor(blockCount, WRITE_BLOCK_POINTS / 4, [&](size_t first, size_t last, size_t chunk) {
+            std::string& text = chunkText[chunk];
+            text.resize((last - first) * maxLine);
+            char* out = &text[0];
+            char* textEnd = out + text.size();
+
+            auto put = [&](auto value, char separator) {
+                out = std::to_chars(out, textEnd, value).ptr;
+                *out++ = separator;
+            };
+            auto putByte = [&](uint8_t value, char separator) {
+                out = std::to_chars(out, textEnd, static_cast<int>(value)).ptr;
+                *out++ = separator;
+            };
+
+            for (size_t k = blockBegin + first; k < blockBegin + last; k++) {
+                size_t i = order.empty() ? k : order[k];
+                const glm::vec3& normal = pointCloud.m_normals[i];
+                if (!ShouldWrite(normal, options)) continue;
+
+                char* lineStart = out;
+                if (options.attributes & PlyAttributePosition) {
+                    const glm::vec3& position = pointCloud.m_positions[i];
+                    if (absolute) {
+                        put(position.x + pointCloud.m_origin.x, ' ');
+                        put(position.y + pointCloud.m_origin.y, ' ');
+                        put(position.z + pointCloud.m_origin.z, ' ');
+                    }
+                    else {
+                        put(position.x, ' ');
+                        put(position.y, ' ');
+                        put(position.z, ' ');
+                    }
+                }
+                if (options.attributes & PlyAttributeNormal) {
+                    put(normal.x, ' ');
+                    put(normal.y, ' ');
+                    put(normal.z, ' ');
+                }
+                if (options.attributes & PlyAttributeColor) {
+                    const glm::vec3& color = pointCloud.m_colors[i];
+                    putByte(ToColorByte(color.x), ' ');
+                    putByte(ToColorByte(color.y), ' ');
+                    putByte(ToColorByte(color.z), ' ');
+                }
+                if (out > lineStart) out[-1] = '\n';
+            }
+            text.resize(out - text.data());
+        });
+
+        for (size_t c = 0; c < chunks; c++) {
+            file.write(chunkText[c].data(), chunkText[c].size());
+        }
+    }
 }
@@ -3,30 +3,168 @@
 #include <vector>
 #include <string>
 #include <iostream>
-#include <fstream>     
-#include <sstream>     
-#include <vector>      
-#include <string>  
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 
 
 #include "PointCloud.h"
+#include "PLY_decoders.h"
+
+// scalar types a PLY property can have (also the element/count type of list properties)
+enum class PlyType : uint8_t {
+	Char,
+	UChar,
+	Short,
+	UShort,
+	Int,
+	UInt,
+	Float,
+	Double,
+	Invalid
+};
+
+enum class PlyFormat {
+	Ascii,
+	BinaryLittleEndian,
+	BinaryBigEndian,
+	Unknown
+};
+
+struct PlyProperty {
+	std::string name;
+	PlyType type = PlyType::Invalid;		// value type, for lists the type of each entry
+	PlyType countType = PlyType::Invalid;	// only used by list properties
+	bool isList = false;
+	size_t offset = 0;						// byte offset inside the element (fixed size elements only)
+};
+
+struct PlyElement {
+	static constexpr size_t UnknownCount = SIZE_MAX;
+
+	std::string name;
+	size_t count = 0;						// UnknownCount: ascii element running to the end of the data (xyz files)
+	std::vector<PlyProperty> properties;
+	size_t stride = 0;						// bytes per element, 0 if the element contains list properties
+
+	int FindProperty(const std::string& propertyName) const;
+};
+
+struct PlyHeader {
+	PlyFormat format = PlyFormat::Unknown;
+	std::vector<PlyElement> elements;
+	size_t dataOffset = 0;					// first byte after "end_header"
+};
+
+size_t PlyTypeSize(PlyType type);
+
+// computes property offsets and element strides once all properties of the header are known
+void ComputeElementLayout(PlyHeader& header);
+
+// indices of the vertex properties the PointCloud consumes, resolved once per file. -1 if not present
+struct PlyVertexLayout {
+	int x = -1, y = -1, z = -1;
+	int nx = -1, ny = -1, nz = -1;
+	int red = -1, green = -1, blue = -1;
+	int rgb = -1;		// packed 0x00RRGGBB in 32 bits (pcd "rgb"/"rgba" fields), used if red/green/blue are missing
+
+	PlyVertexLayout() = default;
+	explicit PlyVertexLayout(const PlyElement& vertex);
+
+	bool HasNormals() const { return nx >= 0 && ny >= 0 && nz >= 0; }
+};
+
+/*
+ * PlyVertexReader
+ *
+ * Sequential decoder for the vertex element of a PLY body (ascii or binary).
+ * Every Read() call decodes the next vertices, so callers can decode the whole
+ * cloud at once or in batches. Point IDs continue across calls.
+ */
+class PlyVertexReader {
+public:
+	bool Init(const char* body, const char* end, const PlyHeader& header);
+	size_t Read(const PointArrays& out, size_t maxPoints);
+
+	// jumps to vertex index (fixed size binary vertices only), lets copies of one reader decode disjoint ranges
+	bool Seek(size_t vertex);
+
+	size_t Total() const { return m_total; }
+	size_t Position() const { return m_next; }
+	bool HasNormals() const { return m_layout.HasNormals(); }
+	size_t BytesConsumed() const { return static_cast<size_t>(m_cursor - m_begin); }
 
+private:
+	size_t ReadBinary(const PointArrays& out, size_t count);
+	size_t ReadAscii(const PointArrays& out, size_t count);
+
+	PlyElement m_vertex;
+	PlyVertexLayout m_layout;
+	PlyFastLayout m_fastLayout;
+	PlyFormat m_format = PlyFormat::Unknown;
+	bool m_swapBytes = false;
+	bool m_fast = false;
+
+	const char* m_begin = nullptr;
+	const char* m_vertexBegin = nullptr;
+	const char* m_cursor = nullptr;
+	const char* m_end = nullptr;
+	size_t m_total = 0;
+	size_t m_next = 0;
+
+	float m_colorScale[3] = { 0.0f, 0.0f, 0.0f };
+	std::vector<size_t> m_offsets;
+	std::vector<float> m_values;
+};
+
+// attributes SavePLY can emit, combine with |
+enum PlyAttribute : uint32_t {
+	PlyAttributePosition = 1 << 0,
+	PlyAttributeNormal = 1 << 1,
+	PlyAttributeColor = 1 << 2
+};
+
+struct PlyWriteOptions {
+	PlyFormat format = PlyFormat::BinaryLittleEndian;	// ascii or binary_little_endian
+	uint32_t attributes = PlyAttributePosition | PlyAttributeNormal;
+	bool skipInvalidNormals = true;						// drop points whose normal is zero or NaN
+};
+
+
+// point file formats PLY_loader::Load can read
+enum class PointFileFormat {
+	PLY,
+	PCD,		// PCL point cloud data, ascii or binary (not binary_compressed)
+	XYZ,		// whitespace or comma separated text, one point per line
+	LAS,		// uncompressed LAS 1.0 - 1.4
+	Unknown
+};
 
 class PLY_loader {
 public:
 
 	bool m_hasNormals = false;
 
+	// loads any supported format, chosen by magic bytes first and file extension second
+	PointCloud Load(const std::string& filepath);
 	PointCloud LoadPLY(const std::string& filepath);
-	void SavePLY(std::string path, PointCloud pointCloud);
+	static PointFileFormat DetectFormat(const std::string& filepath, const char* data, size_t size);
+	static bool ParseHeader(const char* data, size_t size, PlyHeader& header);
+	bool SavePLY(const std::string& path, PointCloudView pointCloud, const PlyWriteOptions& options = PlyWriteOptions());
+
 
-	
 private:
-	//PointCloud ExtractBinaryData(std::ifstream& ply_file);
-	PointCloud ExtractAsciiData(std::ifstream& ply_file, const std::vector<std::string>& property_order, int vertices);
-	PointCloud ExtractBinaryData(std::ifstream& ply_file, const std::vector<std::string>& property_order,int vertices);
+	PointCloud DecodePLY(const char* data, size_t size, const std::string& filepath);
+	PointCloud DecodePCD(const char* data, size_t size, const std::string& filepath);
+	PointCloud DecodeXYZ(const char* data, size_t size, const std::string& filepath);
+	PointCloud DecodeLAS(const char* data, size_t size, const std::string& filepath);
+	PointCloud ExtractAsciiData(const char* begin, const char* end, const PlyHeader& header);
+	PointCloud ExtractBinaryData(const char* begin, const char* end, const PlyHeader& header);
+	void WriteBinaryBody(std::ofstream& file, PointCloudView pointCloud, const std::vector<uint32_t>& order, const PlyWriteOptions& options);
+	void WriteAsciiBody(std::ofstream& file, PointCloudView pointCloud, const std::vector<uint32_t>& order, const PlyWriteOptions& options);
 
 };
-
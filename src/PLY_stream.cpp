@@ -0,0 +1,146 @@
+#include "PLY_stream.h"
+
+PLY_stream::PLY_stream(size_t batchSize, size_t readAhead)
+    : m_batchSize(std::max<size_t>(batchSize, 1)),
+    m_readAhead(std::max<size_t>(readAhead, 1)) {
+}
+
+PLY_stream::~PLY_stream() {
+    Close();
+}
+
+/*
+ * Open
+ *
+ * Maps the file, parses the header and starts the read-ahead thread. The first
+ * batches are decoded while the caller is still setting up its consumer.
+ */
+bool PLY_stream::Open(const std::string& filepath) {
+    Close();
+
+    if (!m_file.Open(filepath)) {
+        std::cerr << "Could not open file: " << filepath << std::endl;
+        return false;
+    }
+
+    m_header = PlyHeader();
+    if (!PLY_loader::ParseHeader(m_file.Data(), m_file.Size(), m_header)) {
+        std::cerr << "Invalid PLY header: " << filepath << std::endl;
+        m_file.Close();
+        return false;
+    }
+
+    if (!m_reader.Init(m_file.Data() + m_header.dataOffset, m_file.Data() + m_file.Size(), m_header)) {
+        m_file.Close();
+        return false;
+    }
+
+    m_total = m_reader.Total();
+    m_hasNormals = m_reader.HasNormals();
+    m_done = false;
+    m_stop = false;
+    m_worker = std::thread(&PLY_stream::ReadAheadLoop, this);
+    return true;
+}
+
+void PLY_stream::Close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_slotFree.notify_all();
+
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+
+    m_queue.clear();
+    m_freeBuffers.clear();
+    m_file.Close();
+    m_total = 0;
+}
+
+/*
+ * ReadAheadLoop
+ *
+ * Background thread: decodes batches as long as fewer than m_readAhead are queued.
+ * Batch storage handed back by the consumer is reused, so after the first few
+ * batches no more allocations happen.
+ */
+void PLY_stream::ReadAheadLoop() {
+    size_t discardedUntil = m_header.dataOffset;
+
+    while (true) {
+        PointCloud buffer;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_slotFree.wait(lock, [&]() { return m_stop || m_queue.size() < m_readAhead; });
+            if (m_stop) return;
+
+            if (!m_freeBuffers.empty()) {
+                buffer = std::move(m_freeBuffers.back());
+                m_freeBuffers.pop_back();
+            }
+        }
+
+        buffer.Resize(m_batchSize);
+        size_t firstID = m_reader.Position();
+        size_t decoded = m_reader.Read(buffer.Arrays(), m_batchSize);
+        buffer.Resize(decoded);
+        buffer.m_hasNormals = m_hasNormals;
+
+        // decoded bytes are not needed anymore, let the OS drop those pages
+        size_t consumedUntil = m_header.dataOffset + m_reader.BytesConsumed();
+        m_file.Discard(discardedUntil, consumedUntil - discardedUntil);
+        discardedUntil = consumedUntil;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (decoded == 0) {
+                m_done = true;
+            }
+            else {
+                PointBatch batch;
+                batch.firstID = firstID;
+                batch.points = std::move(buffer);
+                m_queue.push_back(std::move(batch));
+            }
+        }
+        m_batchReady.notify_one();
+
+        if (decoded == 0) return;
+    }
+}
+
+bool PLY_stream::NextBatch(PointBatch& batch) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // hand the storage of the previous batch back to the reader
+    if (batch.points.m_positions.capacity() > 0 && m_freeBuffers.size() < m_readAhead) {
+        m_freeBuffers.push_back(std::move(batch.points));
+    }
+    batch.points.Clear();
+
+    m_batchReady.wait(lock, [&]() { return !m_queue.empty() || m_done || m_stop; });
+    if (m_queue.empty()) {
+        return false;
+    }
+
+    batch = std::move(m_queue.front());
+    m_queue.pop_front();
+    lock.unlock();
+
+    m_slotFree.notify_one();
+    return true;
+}
+
+size_t PLY_stream::ForEachBatch(const std::function<bool(const PointBatch&)>& onBatch) {
+    size_t delivered = 0;
+    PointBatch batch;
+
+    while (NextBatch(batch)) {
+        delivered += batch.points.Size();
+        if (!onBatch(batch)) break;
+    }
+    return delivered;
+}
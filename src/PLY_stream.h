@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "MappedFile.h"
+#include "PLY_loader.h"
+
+struct PointBatch {
+	size_t firstID = 0;				// ID of the first point, IDs are contiguous inside a batch
+	PointCloud points;
+};
+
+/*
+ * PLY_stream
+ *
+ * Reads the vertices of a PLY file in fixed-size batches instead of loading the
+ * whole cloud into one PointCloud. A background thread decodes up to readAhead
+ * batches ahead of the consumer and already decoded parts of the file mapping
+ * are released, so memory stays bounded by (readAhead + 1) * batchSize points
+ * regardless of the file size. --screen-space reads its ground truth normals
+ * this way.
+ *
+ *   PLY_stream stream;
+ *   stream.Open(path);
+ *   PointBatch batch;
+ *   while (stream.NextBatch(batch)) { ... }
+ */
+class PLY_stream {
+public:
+	explicit PLY_stream(size_t batchSize = 1 << 20, size_t readAhead = 2);
+	~PLY_stream();
+
+	PLY_stream(const PLY_stream&) = delete;
+	PLY_stream& operator=(const PLY_stream&) = delete;
+
+	bool Open(const std::string& filepath);
+	void Close();
+
+	// blocks until the next batch is decoded, returns false once every point was delivered
+	bool NextBatch(PointBatch& batch);
+
+	// calls onBatch for every batch in file order, stops early if it returns false.
+	// returns the number of points delivered
+	size_t ForEachBatch(const std::function<bool(const PointBatch&)>& onBatch);
+
+	size_t PointsTotal() const { return m_total; }
+	bool HasNormals() const { return m_hasNormals; }
+
+private:
+	void ReadAheadLoop();
+
+	MappedFile m_file;
+	PlyHeader m_header;
+	PlyVertexReader m_reader;
+
+	size_t m_batchSize;
+	size_t m_readAhead;
+	size_t m_total = 0;
+	bool m_hasNormals = false;
+
+	std::thread m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_batchReady;
+	std::condition_variable m_slotFree;
+	std::deque<PointBatch> m_queue;
+	std::vector<PointCloud> m_freeBuffers;		// recycled batch storage
+	bool m_done = true;							// nothing to deliver until Open() succeeded
+	bool m_stop = false;
+};
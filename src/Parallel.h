@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/*
+ * Small helpers to split CPU work over all cores. No pool is kept alive, the
+ * workers only live for the duration of one call.
+ */
+
+inline unsigned WorkerCount() {
+    unsigned count = std::thread::hardware_concurrency();
+    return count == 0 ? 1u : count;
+}
+
+/*
+ * ParallelFor
+ *
+ * Splits [0, count) into at most WorkerCount() contiguous ranges of at least
+ * minChunk items and calls fn(begin, end, chunkIndex) for each of them. The
+ * calling thread processes the first range itself. Returns the number of
+ * chunks used, so callers can size per-chunk result arrays beforehand with
+ * ChunkCount().
+ */
+inline size_t ChunkCount(size_t count, size_t minChunk) {
+    if (count == 0) return 0;
+    size_t maxChunks = (count + std::max<size_t>(minChunk, 1) - 1) / std::max<size_t>(minChunk, 1);
+    return std::min<size_t>(WorkerCount(), maxChunks);
+}
+
+// wall time of a stage, for the timing logs around the parallel passes
+inline double MillisecondsSince(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+template <typename Fn>
+size_t ParallelFor(size_t count, size_t minChunk, Fn&& fn) {
+    size_t chunks = ChunkCount(count, minChunk);
+    if (chunks <= 1) {
+        if (count > 0) fn(size_t(0), count, size_t(0));
+        return chunks;
+    }
+
+    size_t chunkSize = (count + chunks - 1) / chunks;
+    std::vector<std::thread> workers;
+    workers.reserve(chunks - 1);
+
+    for (size_t c = 1; c < chunks; ++c) {
+        size_t begin = std::min(count, c * chunkSize);
+        size_t end = std::min(count, begin + chunkSize);
+        workers.emplace_back([&fn, begin, end, c]() { fn(begin, end, c); });
+    }
+    fn(size_t(0), std::min(count, chunkSize), size_t(0));
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return chunks;
+}
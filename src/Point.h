@@ -31,3 +31,9 @@ public:
     glm::vec3 GetNormal() const;
 
 };
+
+// vertex layout of the depth and splat pass (location 0: ID, location 1: position)
+struct PointVertex {
+    int m_pointID;
+    glm::vec3 m_position;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * PointAllocationStats
+ *
+ * Counts every allocation made for per point storage (the arrays of a
+ * PointCloud, the Pack buffers, readback staging). The renderer compares the
+ * counters before and after a frame: in steady state nothing cloud sized may be
+ * allocated, so a non-zero delta means some code path copies a cloud.
+ */
+struct PointAllocationStats {
+    std::atomic<uint64_t> allocations{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+};
+
+inline PointAllocationStats& GetPointAllocationStats() {
+    static PointAllocationStats stats;
+    return stats;
+}
+
+// std::allocator that reports to PointAllocationStats
+template <typename T>
+struct PointAllocator {
+    using value_type = T;
+
+    PointAllocator() = default;
+    template <typename U>
+    PointAllocator(const PointAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        PointAllocationStats& stats = GetPointAllocationStats();
+        stats.allocations.fetch_add(1, std::memory_order_relaxed);
+        stats.bytes.fetch_add(count * sizeof(T), std::memory_order_relaxed);
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T* pointer, size_t count) {
+        std::allocator<T>().deallocate(pointer, count);
+    }
+
+    template <typename U>
+    bool operator==(const PointAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const PointAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using PointVector = std::vector<T, PointAllocator<T>>;
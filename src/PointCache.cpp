@@ -0,0 +1,313 @@
+#include "PointCache.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+    const char CACHE_MAGIC[8] = { 'D', 'N', 'P', 'C', 'A', 'C', 'H', 'E' };
+    const uint32_t CACHE_VERSION = 3;
+    const size_t CACHE_ALIGNMENT = 64;
+
+    enum CacheFlags : uint32_t {
+        CacheHasNormals = 1 << 0
+    };
+
+    struct CacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t pointCount;
+        uint64_t sourceSize;
+        int64_t sourceModified;
+        uint64_t sourceHash;
+        float boundsMin[3];
+        float boundsMax[3];
+        double origin[3];			// PointCloud::m_origin, positions are relative to it
+        uint64_t positionsOffset;	// float[3 * pointCount]
+        uint64_t colorsOffset;		// float[3 * pointCount]
+        uint64_t normalsOffset;		// float[3 * pointCount]
+        uint64_t idsOffset;			// int32[pointCount]
+        uint64_t channelCount;
+        uint64_t channelsOffset;	// CacheChannel[channelCount]
+    };
+
+    // extra channel, values are float[components * pointCount] at valuesOffset
+    struct CacheChannel {
+        char name[48];
+        uint32_t components;
+        uint32_t reserved;
+        uint64_t valuesOffset;
+    };
+
+    // elements * elementSize bytes at offset lie inside a file of size bytes, without overflowing on corrupt headers
+    bool FitsInFile(uint64_t offset, uint64_t elements, uint64_t elementSize, uint64_t size) {
+        return offset <= size && elementSize > 0 && elements <= (size - offset) / elementSize;
+    }
+
+    size_t AlignUp(size_t value) {
+        return (value + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+    }
+
+    uint64_t Mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // word-at-a-time hash of one range, not cryptographic, only to detect changed sources
+    uint64_t HashRange(const char* data, size_t size, uint64_t seed) {
+        uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ULL);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            h = (h ^ Mix(word)) * 0x9e3779b97f4a7c15ULL;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, data + i, size - i);
+        return Mix(h ^ Mix(tail));
+    }
+}
+
+std::string PointCache::CachePath(const std::string& sourcePath) {
+    return sourcePath + ".pcache";
+}
+
+bool PointCache::DescribeSource(const std::string& sourcePath, PointCacheSource& source) {
+    std::error_code error;
+    auto size = std::filesystem::file_size(sourcePath, error);
+    if (error) return false;
+    auto modified = std::filesystem::last_write_time(sourcePath, error);
+    if (error) return false;
+
+    source.size = static_cast<uint64_t>(size);
+    source.modified = static_cast<int64_t>(modified.time_since_epoch().count());
+    source.contentHash = 0;
+    return true;
+}
+
+/*
+ * HashFile
+ *
+ * Hashes the file in parallel chunks of 16 MB and combines the chunk hashes in order.
+ */
+uint64_t PointCache::HashFile(const std::string& path) {
+    MappedFile file;
+    if (!file.Open(path)) return 0;
+
+    const size_t chunkBytes = size_t(16) << 20;
+    size_t chunkCount = (file.Size() + chunkBytes - 1) / chunkBytes;
+    std::vector<uint64_t> chunkHashes(chunkCount);
+
+    ParallelFor(chunkCount, 1, [&](size_t first, size_t last, size_t) {
+        for (size_t c = first; c < last; c++) {
+            size_t begin = c * chunkBytes;
+            chunkHashes[c] = HashRange(file.Data() + begin, std::min(chunkBytes, file.Size() - begin), c);
+        }
+    });
+
+    return HashRange(reinterpret_cast<const char*>(chunkHashes.data()), chunkHashes.size() * sizeof(uint64_t), file.Size());
+}
+
+/*
+ * Load
+ *
+ * Uses the cache next to sourcePath if it was built from the current version of the file,
+ * otherwise loads the source file and writes a new cache for the next start.
+ */
+PointCloud PointCache::Load(const std::string& sourcePath, PLY_loader& loader) {
+    PointCacheSource source;
+    if (!DescribeSource(sourcePath, source)) {
+        std::cerr << "Could not open file: " << sourcePath << std::endl;
+        return {};
+    }
+
+    std::string cachePath = CachePath(sourcePath);
+    PointCloud cloud;
+
+    if (Read(cachePath, sourcePath, source, cloud)) {
+        std::cout << "Loaded " << cloud.PointsAmount() << " points from cache " << cachePath << std::endl;
+        return cloud;
+    }
+
+    cloud = loader.Load(sourcePath);
+    if (cloud.PointsAmount() > 0) {
+        source.contentHash = HashFile(sourcePath);
+        if (Write(cachePath, cloud, source)) {
+            std::cout << "Wrote point cache " << cachePath << std::endl;
+        }
+    }
+    return cloud;
+}
+
+/*
+ * Write
+ *
+ * Writes header, attribute arrays and channels to a temporary file and renames it
+ * afterwards, so an interrupted write never leaves a truncated cache behind.
+ */
+bool PointCache::Write(const std::string& cachePath, PointCloudView cloud, const PointCacheSource& source) {
+    const size_t count = cloud.Size();
+    const size_t vec3Bytes = count * sizeof(glm::vec3);
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.flags = cloud.m_hasNormals ? static_cast<uint32_t>(CacheHasNormals) : 0u;
+    header.pointCount = count;
+    header.sourceSize = source.size;
+    header.sourceModified = source.modified;
+    header.sourceHash = source.contentHash;
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = cloud.m_boundsMin[i];
+        header.boundsMax[i] = cloud.m_boundsMax[i];
+        header.origin[i] = cloud.m_origin[i];
+    }
+    header.positionsOffset = AlignUp(sizeof(CacheHeader));
+    header.colorsOffset = AlignUp(header.positionsOffset + vec3Bytes);
+    header.normalsOffset = AlignUp(header.colorsOffset + vec3Bytes);
+    header.idsOffset = AlignUp(header.normalsOffset + vec3Bytes);
+    header.channelCount = cloud.m_channelCount;
+    header.channelsOffset = AlignUp(header.idsOffset + count * sizeof(int32_t));
+
+    std::vector<CacheChannel> channels(cloud.m_channelCount);
+    uint64_t nextOffset = AlignUp(header.channelsOffset + channels.size() * sizeof(CacheChannel));
+    for (size_t c = 0; c < channels.size(); c++) {
+        const PointChannel& channel = cloud.m_channels[c];
+        std::strncpy(channels[c].name, channel.name.c_str(), sizeof(channels[c].name) - 1);
+        channels[c].components = static_cast<uint32_t>(channel.components);
+        channels[c].valuesOffset = nextOffset;
+        nextOffset = AlignUp(nextOffset + channel.values.size() * sizeof(float));
+    }
+
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Could not write point cache: " << cachePath << std::endl;
+        return false;
+    }
+
+    // the arrays are written as they are stored in the cloud, padded to their aligned offset
+    auto writeAt = [&](uint64_t offset, const void* data, size_t bytes) {
+        static const char zeros[CACHE_ALIGNMENT] = {};
+        size_t position = static_cast<size_t>(file.tellp());
+        file.write(zeros, offset - position);
+        file.write(static_cast<const char*>(data), bytes);
+    };
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeAt(header.positionsOffset, cloud.m_positions, vec3Bytes);
+    writeAt(header.colorsOffset, cloud.m_colors, vec3Bytes);
+    writeAt(header.normalsOffset, cloud.m_normals, vec3Bytes);
+    writeAt(header.idsOffset, cloud.m_ids, count * sizeof(int32_t));
+    writeAt(header.channelsOffset, channels.data(), channels.size() * sizeof(CacheChannel));
+    for (size_t c = 0; c < channels.size(); c++) {
+        writeAt(channels[c].valuesOffset, cloud.m_channels[c].values.data(), cloud.m_channels[c].values.size() * sizeof(float));
+    }
+
+    bool ok = file.good();
+    file.close();
+
+    std::error_code error;
+    if (ok) {
+        std::filesystem::rename(tempPath, cachePath, error);
+    }
+    if (!ok || error) {
+        std::filesystem::remove(tempPath, error);
+        std::cerr << "Could not write point cache: " << cachePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Read
+ *
+ * Maps the cache and validates it against the source file. A cache is stale if the
+ * source size differs, or if the modification time differs and the content hash
+ * does not match anymore (touched or copied files keep their cache).
+ */
+bool PointCache::Read(const std::string& cachePath, const std::string& sourcePath, const PointCacheSource& source, PointCloud& cloud) {
+    std::error_code error;
+    if (!std::filesystem::exists(cachePath, error)) return false;
+
+    MappedFile file;
+    if (!file.Open(cachePath) || file.Size() < sizeof(CacheHeader)) return false;
+
+    CacheHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION) {
+        std::cerr << "Ignoring incompatible point cache: " << cachePath << std::endl;
+        return false;
+    }
+
+    if (header.sourceSize != source.size) return false;
+    bool touched = header.sourceModified != source.modified;
+    if (touched && header.sourceHash != HashFile(sourcePath)) return false;
+
+    // every array has to lie inside the mapping before anything is allocated or copied
+    const uint64_t fileSize = file.Size();
+    const size_t count = static_cast<size_t>(header.pointCount);
+    bool complete = FitsInFile(header.positionsOffset, header.pointCount, sizeof(glm::vec3), fileSize)
+        && FitsInFile(header.colorsOffset, header.pointCount, sizeof(glm::vec3), fileSize)
+        && FitsInFile(header.normalsOffset, header.pointCount, sizeof(glm::vec3), fileSize)
+        && FitsInFile(header.idsOffset, header.pointCount, sizeof(int32_t), fileSize)
+        && FitsInFile(header.channelsOffset, header.channelCount, sizeof(CacheChannel), fileSize);
+    const CacheChannel* channels = complete ? reinterpret_cast<const CacheChannel*>(file.Data() + header.channelsOffset) : nullptr;
+    for (uint64_t c = 0; complete && c < header.channelCount; c++) {
+        complete = channels[c].components > 0
+            && FitsInFile(channels[c].valuesOffset, header.pointCount, uint64_t(channels[c].components) * sizeof(float), fileSize);
+    }
+    if (!complete) {
+        std::cerr << "Ignoring truncated point cache: " << cachePath << std::endl;
+        return false;
+    }
+
+    // the cache stores the arrays exactly like the cloud does, so loading is a parallel copy
+    auto copyArray = [&](void* destination, uint64_t offset, size_t bytes) {
+        const char* source = file.Data() + offset;
+        ParallelFor(bytes, size_t(1) << 20, [&](size_t first, size_t last, size_t) {
+            std::memcpy(static_cast<char*>(destination) + first, source + first, last - first);
+        });
+    };
+
+    cloud.m_channels.clear();
+    for (uint64_t c = 0; c < header.channelCount; c++) {
+        std::string name(channels[c].name, strnlen(channels[c].name, sizeof(channels[c].name)));
+        cloud.AddChannel(name, static_cast<int>(channels[c].components));
+    }
+    cloud.Resize(count);
+
+    copyArray(cloud.m_positions.data(), header.positionsOffset, count * sizeof(glm::vec3));
+    copyArray(cloud.m_colors.data(), header.colorsOffset, count * sizeof(glm::vec3));
+    copyArray(cloud.m_normals.data(), header.normalsOffset, count * sizeof(glm::vec3));
+    copyArray(cloud.m_ids.data(), header.idsOffset, count * sizeof(int32_t));
+    for (uint64_t c = 0; c < header.channelCount; c++) {
+        copyArray(cloud.m_channels[c].values.data(), channels[c].valuesOffset, cloud.m_channels[c].values.size() * sizeof(float));
+    }
+
+    cloud.m_hasNormals = (header.flags & CacheHasNormals) != 0;
+    cloud.m_boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    cloud.m_boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    cloud.m_origin = glm::dvec3(header.origin[0], header.origin[1], header.origin[2]);
+
+    // same content with a new time stamp, store it so the next start skips the hash
+    if (touched) {
+        file.Close();
+        std::fstream patch(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+        patch.seekp(offsetof(CacheHeader, sourceModified));
+        patch.write(reinterpret_cast<const char*>(&source.modified), sizeof(source.modified));
+        if (!patch) {
+            std::cerr << "Could not update the time stamp of point cache: " << cachePath << std::endl;
+        }
+    }
+    return true;
+}
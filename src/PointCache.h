@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "PLY_loader.h"
+#include "PointCloud.h"
+
+/*
+ * PointCache
+ *
+ * Binary cache written next to a source point file (<file>.ply.pcache, <file>.las.pcache, ...). It stores the
+ * positions, colors, normals, IDs and extra channels of the cloud in separate 64 byte
+ * aligned arrays together with the point count, the bounds, the origin and the size, modification
+ * time and content hash of the source file. The arrays have the same layout as the
+ * PointCloud arrays, so loading a valid cache is a mapping plus a parallel copy.
+ *
+ * The cache is rebuilt automatically whenever the source file changes.
+ */
+
+// identity of the source file a cache was built from
+struct PointCacheSource {
+	uint64_t size = 0;
+	int64_t modified = 0;
+	uint64_t contentHash = 0;	// only computed if size matches but modification time does not
+};
+
+class PointCache {
+public:
+	static std::string CachePath(const std::string& sourcePath);
+
+	// Loads sourcePath (any format PLY_loader::Load reads) through its cache, (re)building the cache if it is missing or stale
+	static PointCloud Load(const std::string& sourcePath, PLY_loader& loader);
+
+	static bool Write(const std::string& cachePath, PointCloudView cloud, const PointCacheSource& source);
+	static bool Read(const std::string& cachePath, const std::string& sourcePath, const PointCacheSource& source, PointCloud& cloud);
+
+	static bool DescribeSource(const std::string& sourcePath, PointCacheSource& source);
+	static uint64_t HashFile(const std::string& path);
+};
@@ -1,29 +1,322 @@
 #include "PointCloud.h"
+#include "Parallel.h"
 
-Point* PointCloud::GetPointByID(int id)
+#include <iostream>
+
+void PointCloud::Resize(size_t count)
 {
-	for (auto& point : m_points) {
-		if (point.m_pointID == id)
-			return &point;
+	m_idIndex.valid = false;
+	m_ids.resize(count, -1);
+	m_positions.resize(count, glm::vec3(0.0f));
+	m_colors.resize(count, glm::vec3(1.0f));
+	m_normals.resize(count, glm::vec3(0.0f));
+	for (auto& channel : m_channels) {
+		channel.values.resize(count * channel.components, 0.0f);
 	}
-	return nullptr;
+}
+
+void PointCloud::Clear()
+{
+	Resize(0);
+}
+
+void PointCloud::AddPoint(const Point& point)
+{
+	m_idIndex.valid = false;
+	m_ids.push_back(point.m_pointID);
+	m_positions.push_back(point.m_position);
+	m_colors.push_back(point.m_color);
+	m_normals.push_back(point.m_normal);
+	for (auto& channel : m_channels) {
+		channel.values.resize(m_positions.size() * channel.components, 0.0f);
+	}
+}
+
+Point PointCloud::GetPoint(size_t index) const
+{
+	Point point;
+	point.m_pointID = m_ids[index];
+	point.m_position = m_positions[index];
+	point.m_color = m_colors[index];
+	point.m_normal = m_normals[index];
+	return point;
+}
+
+PointArrays PointCloud::Arrays(size_t first)
+{
+	m_idIndex.valid = false;
+	return { m_ids.data() + first, m_positions.data() + first, m_colors.data() + first, m_normals.data() + first };
+}
+
+namespace {
+
+	template <typename T>
+	void GatherArray(PointVector<T>& values, const std::vector<uint32_t>& indices, size_t components = 1)
+	{
+		PointVector<T> gathered(indices.size() * components);
+		ParallelFor(indices.size(), 1 << 16, [&](size_t first, size_t last, size_t) {
+			for (size_t i = first; i < last; i++) {
+				for (size_t c = 0; c < components; c++) {
+					gathered[i * components + c] = values[indices[i] * components + c];
+				}
+			}
+		});
+		values.swap(gathered);
+	}
+}
+
+void PointCloud::Gather(const std::vector<uint32_t>& indices)
+{
+	GatherArray(m_ids, indices);
+	GatherArray(m_positions, indices);
+	GatherArray(m_colors, indices);
+	GatherArray(m_normals, indices);
+	for (auto& channel : m_channels) {
+		GatherArray(channel.values, indices, channel.components);
+	}
+
+	// IDs move with their points, so only the table entries change
+	if (m_idIndex.valid) {
+		std::fill(m_indexOfID.begin(), m_indexOfID.end(), -1);
+		for (size_t i = 0; i < m_ids.size(); i++) {
+			if (m_ids[i] >= 0) m_indexOfID[m_ids[i]] = static_cast<int>(i);
+		}
+	}
+}
+
+void PointCloud::Reorder(const std::vector<uint32_t>& order)
+{
+	if (order.size() != Size()) {
+		std::cerr << "Reorder needs one index per point." << std::endl;
+		return;
+	}
+	Gather(order);
+}
+
+void PointCloud::Filter(const std::vector<uint8_t>& keep)
+{
+	std::vector<uint32_t> kept;
+	kept.reserve(Size());
+	for (size_t i = 0; i < keep.size() && i < Size(); i++) {
+		if (keep[i]) kept.push_back(static_cast<uint32_t>(i));
+	}
+	Gather(kept);
+}
+
+void PointCloud::BuildIDIndex() const
+{
+	int maxID = -1;
+	for (int id : m_ids) maxID = std::max(maxID, id);
+
+	m_indexOfID.assign(static_cast<size_t>(maxID + 1), -1);
+	for (size_t i = 0; i < m_ids.size(); i++) {
+		if (m_ids[i] >= 0) m_indexOfID[m_ids[i]] = static_cast<int>(i);
+	}
+	m_idIndex.valid.store(true, std::memory_order_release);
+}
+
+void PointCloud::EnsureIDIndex() const
+{
+	if (m_idIndex.valid.load(std::memory_order_acquire)) return;
+
+	// the first lookup builds, concurrent ones wait for it and find the index valid
+	std::lock_guard<std::mutex> lock(m_idIndex.mutex);
+	if (!m_idIndex.valid.load(std::memory_order_relaxed)) BuildIDIndex();
+}
+
+int PointCloud::FindIndexByID(int id) const
+{
+	EnsureIDIndex();
+	return (id >= 0 && static_cast<size_t>(id) < m_indexOfID.size()) ? m_indexOfID[id] : -1;
+}
+
+void PointCloud::FindIndicesByID(const int* ids, size_t count, int* indices) const
+{
+	EnsureIDIndex();
+	ParallelFor(count, 1 << 16, [&](size_t first, size_t last, size_t) {
+		for (size_t i = first; i < last; i++) {
+			int id = ids[i];
+			indices[i] = (id >= 0 && static_cast<size_t>(id) < m_indexOfID.size()) ? m_indexOfID[id] : -1;
+		}
+	});
+}
+
+glm::vec3 PointCloud::GetColorByID(int id) const
+{
+	int index = FindIndexByID(id);
+	return index >= 0 ? m_colors[index] : glm::vec3(0.0f); //if no result
+}
+
+glm::vec3 PointCloud::GetNormalByID(int id) const
+{
+	int index = FindIndexByID(id);
+	return index >= 0 ? m_normals[index] : glm::vec3(0.0f);
+}
+
+void PointCloud::ComputeBounds()
+{
+	if (m_positions.empty()) {
+		m_boundsMin = m_boundsMax = glm::vec3(0.0f);
+		return;
+	}
+
+	m_boundsMin = m_boundsMax = m_positions[0];
+	for (const auto& position : m_positions) {
+		m_boundsMin = glm::min(m_boundsMin, position);
+		m_boundsMax = glm::max(m_boundsMax, position);
+	}
+}
+
+PointChannel& PointCloud::AddChannel(const std::string& name, int components)
+{
+	PointChannel* existing = FindChannel(name);
+	if (existing != nullptr) {
+		return *existing;
 	}
 
-glm::vec3 PointCloud::GetColorByID(int id)
+	PointChannel channel;
+	channel.name = name;
+	channel.components = components;
+	channel.values.resize(Size() * components, 0.0f);
+	m_channels.push_back(std::move(channel));
+	return m_channels.back();
+}
+
+PointChannel* PointCloud::FindChannel(const std::string& name)
 {
-	for (auto& point : m_points) {
-		if (point.m_pointID == id)
-			return point.m_color;
+	for (auto& channel : m_channels) {
+		if (channel.name == name)
+			return &channel;
 	}
-	return glm::vec3(0.0f); //if no result
+	return nullptr;
+}
+
+const PointChannel* PointCloud::FindChannel(const std::string& name) const
+{
+	return const_cast<PointCloud*>(this)->FindChannel(name);
+}
+
+PointVector<PointVertex> PointCloud::PackVertices() const
+{
+	PointVector<PointVertex> vertices(Size());
+	ParallelFor(Size(), 1 << 16, [&](size_t first, size_t last, size_t) {
+		for (size_t i = first; i < last; i++) {
+			vertices[i].m_pointID = static_cast<int>(i);
+			vertices[i].m_position = m_positions[i];
+		}
+	});
+	return vertices;
+}
+
+PointVector<Point> PointCloud::PackPoints() const
+{
+	PointVector<Point> points(Size());
+	ParallelFor(Size(), 1 << 16, [&](size_t first, size_t last, size_t) {
+		for (size_t i = first; i < last; i++) {
+			points[i].m_pointID = m_ids[i];
+			points[i].m_position = m_positions[i];
+			points[i].m_color = m_colors[i];
+			points[i].m_normal = m_normals[i];
+		}
+	});
+	return points;
+}
+
+PointVector<glm::vec4> PointCloud::PackNormals() const
+{
+	PointVector<glm::vec4> normals(Size());
+	ParallelFor(Size(), 1 << 16, [&](size_t first, size_t last, size_t) {
+		for (size_t i = first; i < last; i++) {
+			normals[i] = glm::vec4(m_normals[i], 0.0f);
+		}
+	});
+	return normals;
 }
 
-glm::vec3 PointCloud::GetNormalByID(int id)
+PointVector<glm::vec4> PointCloud::PackNormalsByID(const int* ids, size_t count) const
 {
-	for (auto& point : m_points) {
-		if (point.m_pointID == id) {
-			return point.m_normal;
+	EnsureIDIndex();
+	PointVector<glm::vec4> normals(count);
+	ParallelFor(count, 1 << 16, [&](size_t first, size_t last, size_t) {
+		for (size_t i = first; i < last; i++) {
+			int id = ids[i];
+			int index = (id >= 0 && static_cast<size_t>(id) < m_indexOfID.size()) ? m_indexOfID[id] : -1;
+			normals[i] = index >= 0 ? glm::vec4(m_normals[index], 0.0f) : glm::vec4(0.0f);
 		}
+	});
+	return normals;
+}
+
+void PointCloud::UnpackShading(const Point* points, size_t count)
+{
+	count = std::min(count, Size());
+	ParallelFor(count, 1 << 16, [&](size_t first, size_t last, size_t) {
+		for (size_t i = first; i < last; i++) {
+			m_normals[i] = points[i].m_normal;
+			m_colors[i] = points[i].m_color;
+		}
+	});
+}
+
+void PointCloud::PackShading(Point* points, size_t count) const
+{
+	count = std::min(count, Size());
+	ParallelFor(count, 1 << 16, [&](size_t first, size_t last, size_t) {
+		for (size_t i = first; i < last; i++) {
+			points[i].m_normal = m_normals[i];
+			points[i].m_color = m_colors[i];
+		}
+	});
+}
+
+PointCloudView::PointCloudView(const PointCloud& cloud)
+	: m_count(cloud.Size()),
+	  m_hasNormals(cloud.m_hasNormals),
+	  m_ids(cloud.m_ids.data()),
+	  m_positions(cloud.m_positions.data()),
+	  m_colors(cloud.m_colors.data()),
+	  m_normals(cloud.m_normals.data()),
+	  m_channels(cloud.m_channels.data()),
+	  m_channelCount(cloud.m_channels.size()),
+	  m_boundsMin(cloud.m_boundsMin),
+	  m_boundsMax(cloud.m_boundsMax),
+	  m_origin(cloud.m_origin),
+	  m_cloud(&cloud)
+{
+}
+
+Point PointCloudView::GetPoint(size_t index) const
+{
+	Point point;
+	point.m_pointID = m_ids[index];
+	point.m_position = m_positions[index];
+	point.m_color = m_colors[index];
+	point.m_normal = m_normals[index];
+	return point;
+}
+
+int PointCloudView::FindIndexByID(int id) const
+{
+	return m_cloud != nullptr ? m_cloud->FindIndexByID(id) : -1;
+}
+
+glm::vec3 PointCloudView::GetNormalByID(int id) const
+{
+	int index = FindIndexByID(id);
+	return index >= 0 ? m_normals[index] : glm::vec3(0.0f);
+}
+
+glm::vec3 PointCloudView::GetColorByID(int id) const
+{
+	int index = FindIndexByID(id);
+	return index >= 0 ? m_colors[index] : glm::vec3(0.0f);
+}
+
+const PointChannel* PointCloudView::FindChannel(const std::string& name) const
+{
+	for (size_t c = 0; c < m_channelCount; c++) {
+		if (m_channels[c].name == name)
+			return &m_channels[c];
 	}
-	return glm::vec3(0.0f);
+	return nullptr;
 }
@@ -1,24 +1,181 @@
 #pragma once
 
 #include "Point.h"
+#include "PointAllocator.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
 #include <vector>
 
+// additional per point attribute (LAS intensity, ...), stored next to the built-in channels
+struct PointChannel {
+    std::string name;
+    int components = 1;             // floats per point
+    PointVector<float> values;      // components * Size() values
+};
+
+/*
+ * Raw write access to the built-in channels of a cloud, starting at one point.
+ * Decoders fill clouds through this, so they only touch the arrays they produce.
+ */
+struct PointArrays {
+    int* ids = nullptr;
+    glm::vec3* positions = nullptr;
+    glm::vec3* colors = nullptr;
+    glm::vec3* normals = nullptr;
+
+    PointArrays Offset(size_t count) const {
+        return { ids + count, positions + count, colors + count, normals + count };
+    }
+};
+
+/*
+ * PointCloud
+ *
+ * Structure of arrays: IDs, positions, colors and normals live in separate
+ * contiguous arrays, so CPU passes only stream the attributes they use. The
+ * 64 byte Point layout only exists as GPU upload format, built by the Pack
+ * functions for exactly the buffers that need it.
+ *
+ * Lookups by point ID go through a dense ID -> index table. It is rebuilt on the
+ * first lookup after the points changed; Reorder() and Filter() keep it valid.
+ * Code that writes m_ids directly has to call InvalidateIDIndex(). The rebuild
+ * is locked, so const lookups may run on several threads at once; changing the
+ * points while others read them is not.
+ *
+ * All per point storage goes through PointAllocator, so whole-cloud copies show
+ * up in PointAllocationStats. Pass clouds to read-only consumers as a
+ * PointCloudView and move them everywhere else.
+ */
 class PointCloud {
 public:
 
-    void AddPoint(const Point& point) {
-        m_points.push_back(point);
+    size_t Size() const {
+        return m_positions.size();
     }
 
     int PointsAmount() const {
-        return static_cast<int>(m_points.size());
+        return static_cast<int>(m_positions.size());
     }
 
-    Point* GetPointByID(int id);
-    glm::vec3 GetNormalByID(int id);
-    glm::vec3 GetColorByID(int id);
+    // new points get ID -1, white color and a zero normal (like Point())
+    void Resize(size_t count);
+    void Clear();
+
+    void AddPoint(const Point& point);
+    Point GetPoint(size_t index) const;
+
+    PointArrays Arrays(size_t first = 0);   // invalidates the ID index
+
+    // point i of the result is point order[i] of the cloud, all channels are permuted
+    void Reorder(const std::vector<uint32_t>& order);
+    // keeps the points with keep[i] != 0, in their current order
+    void Filter(const std::vector<uint8_t>& keep);
+
+    int FindIndexByID(int id) const;   // -1 if there is no point with this ID
+    void FindIndicesByID(const int* ids, size_t count, int* indices) const;
+    glm::vec3 GetNormalByID(int id) const;
+    glm::vec3 GetColorByID(int id) const;
+    void InvalidateIDIndex() { m_idIndex.valid = false; }
+
+    void ComputeBounds();
+
+    // extra channels are resized together with the built-in ones
+    PointChannel& AddChannel(const std::string& name, int components);
+    PointChannel* FindChannel(const std::string& name);
+    const PointChannel* FindChannel(const std::string& name) const;
+
+    // GPU layouts, every buffer gets only what its shaders read
+    // GPU buffers are indexed by the position of a point in the cloud, which is also the
+    // ID the depth and splat pass write. m_ids only differs from it after a Reorder()
+    PointVector<PointVertex> PackVertices() const;  // index + position (depth and splat pass)
+    PointVector<Point> PackPoints() const;          // full Point layout (average_normal.comp output, display)
+    PointVector<glm::vec4> PackNormals() const;     // std430 vec4 normals (ground truth comparison)
+    PointVector<glm::vec4> PackNormalsByID(const int* ids, size_t count) const;    // normals of the points with these IDs, zero if missing
+    void UnpackShading(const Point* points, size_t count);  // normals and colors read back from a Point buffer
+    void PackShading(Point* points, size_t count) const;    // normals and colors into a packed Point buffer
 
 public:
     bool m_hasNormals = false;
-    std::vector<Point> m_points;
+
+    PointVector<int> m_ids;
+    PointVector<glm::vec3> m_positions;
+    PointVector<glm::vec3> m_colors;
+    PointVector<glm::vec3> m_normals;
+    std::vector<PointChannel> m_channels;
+
+    // axis aligned bounds of all positions, valid after ComputeBounds() (or a cache load)
+    glm::vec3 m_boundsMin = glm::vec3(0.0f);
+    glm::vec3 m_boundsMax = glm::vec3(0.0f);
+
+    // positions are relative to this point; loaders of georeferenced data (LAS) move it to the data so
+    // the float positions keep their precision, SavePLY adds it back
+    glm::dvec3 m_origin = glm::dvec3(0.0);
+
+private:
+    void Gather(const std::vector<uint32_t>& indices);
+    void BuildIDIndex() const;
+    void EnsureIDIndex() const;
+
+    // lock of the lazy index build; a copy gets its own mutex and the valid state of the copied index
+    struct IDIndexState {
+        std::mutex mutex;
+        std::atomic<bool> valid{ false };
+
+        IDIndexState() = default;
+        IDIndexState(const IDIndexState& other) : valid(other.valid.load()) {}
+        IDIndexState& operator=(const IDIndexState& other) { valid = other.valid.load(); return *this; }
+    };
+
+    mutable PointVector<int> m_indexOfID;   // m_indexOfID[id] = index or -1, IDs are expected to be dense
+    mutable IDIndexState m_idIndex;
+};
+
+/*
+ * PointCloudView
+ *
+ * Read-only, non-owning view of a PointCloud: pointers to its arrays plus the
+ * metadata consumers need. It is two cache lines to copy regardless of the
+ * point count, so per frame code and writers take it by value. The view is valid
+ * while the cloud is alive and not resized; ID lookups use the table of the cloud.
+ */
+class PointCloudView {
+public:
+    PointCloudView() = default;
+    PointCloudView(const PointCloud& cloud);    // implicit, consumers can be handed a cloud directly
+
+    size_t Size() const {
+        return m_count;
+    }
+
+    int PointsAmount() const {
+        return static_cast<int>(m_count);
+    }
+
+    Point GetPoint(size_t index) const;
+
+    int FindIndexByID(int id) const;   // -1 if there is no point with this ID
+    glm::vec3 GetNormalByID(int id) const;
+    glm::vec3 GetColorByID(int id) const;
+
+    const PointChannel* FindChannel(const std::string& name) const;
+
+public:
+    size_t m_count = 0;
+    bool m_hasNormals = false;
+
+    const int* m_ids = nullptr;
+    const glm::vec3* m_positions = nullptr;
+    const glm::vec3* m_colors = nullptr;
+    const glm::vec3* m_normals = nullptr;
+    const PointChannel* m_channels = nullptr;
+    size_t m_channelCount = 0;
+
+    glm::vec3 m_boundsMin = glm::vec3(0.0f);
+    glm::vec3 m_boundsMax = glm::vec3(0.0f);
+    glm::dvec3 m_origin = glm::dvec3(0.0);
+
+private:
+    const PointCloud* m_cloud = nullptr;
 };
@@ -0,0 +1,413 @@
+#include "PLY_loader.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+/*
+ * Readers for the non-PLY point formats.
+ *
+ * PCD and XYZ bodies are plain vertex tables, so their headers are translated into
+ * a PlyHeader with a single "vertex" element and decoded by the same parallel ascii
+ * and binary paths as PLY files. LAS stores fixed point coordinates and gets its
+ * own parallel record decoder.
+ */
+
+namespace {
+
+    std::string Lowercase(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    std::string Extension(const std::string& filepath) {
+        size_t dot = filepath.find_last_of('.');
+        size_t slash = filepath.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return {};
+        return Lowercase(filepath.substr(dot + 1));
+    }
+
+    bool StartsWith(const char* data, size_t size, const char* magic) {
+        size_t length = std::strlen(magic);
+        return size >= length && std::memcmp(data, magic, length) == 0;
+    }
+
+    // returns the line starting at cursor without line break and moves cursor behind it
+    std::string NextLine(const char*& cursor, const char* end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+        if (lineEnd == nullptr) lineEnd = end;
+
+        std::string line(cursor, lineEnd);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        cursor = (lineEnd < end) ? lineEnd + 1 : end;
+        return line;
+    }
+
+    PlyType PcdType(char type, size_t size) {
+        switch (type) {
+        case 'F': return size == 8 ? PlyType::Double : (size == 4 ? PlyType::Float : PlyType::Invalid);
+        case 'U': return size == 1 ? PlyType::UChar : size == 2 ? PlyType::UShort : size == 4 ? PlyType::UInt : PlyType::Invalid;
+        case 'I': return size == 1 ? PlyType::Char : size == 2 ? PlyType::Short : size == 4 ? PlyType::Int : PlyType::Invalid;
+        default:  return PlyType::Invalid;
+        }
+    }
+
+    // PCL names normals normal_x/y/z, everything else already matches the PLY names
+    std::string PcdPropertyName(const std::string& field) {
+        if (field == "normal_x") return "nx";
+        if (field == "normal_y") return "ny";
+        if (field == "normal_z") return "nz";
+        return field;
+    }
+
+    /*
+     * Parses a PCD header (v0.5 - v0.7) into a PlyHeader with one "vertex" element.
+     * Fields with COUNT > 1 become one property per entry (name_0, name_1, ...).
+     */
+    bool ParsePcdHeader(const char* data, size_t size, PlyHeader& header) {
+        const char* cursor = data;
+        const char* end = data + size;
+
+        std::vector<std::string> fields;
+        std::vector<size_t> sizes;
+        std::vector<char> types;
+        std::vector<size_t> counts;
+        size_t width = 0, height = 1, points = 0;
+
+        while (cursor < end) {
+            std::istringstream iss(NextLine(cursor, end));
+            std::string keyword;
+            iss >> keyword;
+
+            if (keyword.empty() || keyword[0] == '#') continue;
+
+            if (keyword == "FIELDS" || keyword == "COLUMNS") {
+                for (std::string field; iss >> field; ) fields.push_back(field);
+            }
+            else if (keyword == "SIZE") {
+                for (size_t value; iss >> value; ) sizes.push_back(value);
+            }
+            else if (keyword == "TYPE") {
+                for (char value; iss >> value; ) types.push_back(value);
+            }
+            else if (keyword == "COUNT") {
+                for (size_t value; iss >> value; ) counts.push_back(value);
+            }
+            else if (keyword == "WIDTH") iss >> width;
+            else if (keyword == "HEIGHT") iss >> height;
+            else if (keyword == "POINTS") iss >> points;
+            else if (keyword == "DATA") {
+                std::string format;
+                iss >> format;
+                if (format == "ascii") header.format = PlyFormat::Ascii;
+                else if (format == "binary") header.format = PlyFormat::BinaryLittleEndian;
+                else {
+                    std::cerr << "Unsupported PCD data format: " << format << std::endl;
+                    return false;
+                }
+                header.dataOffset = static_cast<size_t>(cursor - data);
+                break;
+            }
+        }
+
+        if (header.format == PlyFormat::Unknown || fields.empty() || sizes.size() != fields.size() || types.size() != fields.size()) {
+            std::cerr << "Invalid PCD header." << std::endl;
+            return false;
+        }
+        if (counts.empty()) counts.assign(fields.size(), 1);
+
+        PlyElement vertex;
+        vertex.name = "vertex";
+        vertex.count = points > 0 ? points : width * height;
+
+        for (size_t f = 0; f < fields.size(); f++) {
+            PlyType type = PcdType(types[f], sizes[f]);
+            if (type == PlyType::Invalid) {
+                std::cerr << "Unknown PCD field type: " << fields[f] << " " << types[f] << sizes[f] << std::endl;
+                return false;
+            }
+
+            size_t count = f < counts.size() ? counts[f] : 1;
+            for (size_t c = 0; c < count; c++) {
+                PlyProperty prop;
+                prop.name = count == 1 ? PcdPropertyName(fields[f]) : fields[f] + "_" + std::to_string(c);
+                prop.type = type;
+                vertex.properties.push_back(prop);
+            }
+        }
+
+        header.elements.push_back(vertex);
+        ComputeElementLayout(header);
+        return true;
+    }
+
+    // a group of three xyz columns holds a color if all values are integers and one of them is above 1
+    bool LooksLikeColor(const std::vector<std::string>& tokens, size_t first) {
+        bool aboveOne = false;
+        for (size_t i = first; i < first + 3; i++) {
+            if (tokens[i].find_first_of(".eE") != std::string::npos) return false;
+            int value = 0;
+            auto result = std::from_chars(tokens[i].data(), tokens[i].data() + tokens[i].size(), value);
+            if (result.ec != std::errc() || value < 0 || value > 255) return false;
+            aboveOne |= value > 1;
+        }
+        return aboveOne;
+    }
+
+    /*
+     * Builds the vertex schema of an xyz file from its first data line:
+     * x y z, then up to two groups of three columns that are either a color (integers 0..255)
+     * or a normal. Other columns are parsed and ignored. Comment lines (#) before the data are skipped.
+     */
+    bool ParseXyzHeader(const char* data, size_t size, PlyHeader& header) {
+        const char* cursor = data;
+        const char* end = data + size;
+        std::vector<std::string> tokens;
+
+        while (cursor < end && tokens.empty()) {
+            const char* lineBegin = cursor;
+            std::string line = NextLine(cursor, end);
+            if (line.find_first_not_of(" \t") == std::string::npos || line[line.find_first_not_of(" \t")] == '#') continue;
+
+            std::replace(line.begin(), line.end(), ',', ' ');
+            std::istringstream iss(line);
+            for (std::string token; iss >> token; ) tokens.push_back(token);
+            header.dataOffset = static_cast<size_t>(lineBegin - data);
+        }
+
+        if (tokens.size() < 3) {
+            std::cerr << "XYZ file needs at least three columns." << std::endl;
+            return false;
+        }
+
+        std::vector<std::string> names = { "x", "y", "z" };
+        bool hasColor = false, hasNormal = false;
+        for (size_t group = 3; group + 3 <= tokens.size() && group <= 6; group += 3) {
+            if (!hasColor && LooksLikeColor(tokens, group)) {
+                names.insert(names.end(), { "red", "green", "blue" });
+                hasColor = true;
+            }
+            else if (!hasNormal) {
+                names.insert(names.end(), { "nx", "ny", "nz" });
+                hasNormal = true;
+            }
+        }
+        while (names.size() < tokens.size()) names.push_back("column_" + std::to_string(names.size()));
+
+        PlyElement vertex;
+        vertex.name = "vertex";
+        vertex.count = PlyElement::UnknownCount;
+        for (const std::string& name : names) {
+            PlyProperty prop;
+            prop.name = name;
+            prop.type = (name == "red" || name == "green" || name == "blue") ? PlyType::UChar : PlyType::Float;
+            vertex.properties.push_back(prop);
+        }
+
+        header.format = PlyFormat::Ascii;
+        header.elements.push_back(vertex);
+        ComputeElementLayout(header);
+        return true;
+    }
+
+    template <typename T>
+    T ReadLE(const char* src) {
+        T value;
+        std::memcpy(&value, src, sizeof(T));
+        return value;
+    }
+
+    // byte offset of the red/green/blue words inside a LAS point record, 0 if the format has no color
+    size_t LasColorOffset(uint8_t pointFormat) {
+        switch (pointFormat) {
+        case 2:  return 20;
+        case 3:
+        case 5:  return 28;
+        case 7:
+        case 8:
+        case 10: return 30;
+        default: return 0;
+        }
+    }
+}
+
+/*
+ * DetectFormat
+ *
+ * Magic bytes decide first ("ply", "LASF"), then the file extension. Files without
+ * either are treated as PCD if they carry a DATA line, otherwise as xyz text.
+ */
+PointFileFormat PLY_loader::DetectFormat(const std::string& filepath, const char* data, size_t size) {
+    if (StartsWith(data, size, "ply")) return PointFileFormat::PLY;
+    if (StartsWith(data, size, "LASF")) return PointFileFormat::LAS;
+
+    std::string extension = Extension(filepath);
+    if (extension == "ply") return PointFileFormat::PLY;
+    if (extension == "pcd") return PointFileFormat::PCD;
+    if (extension == "las") return PointFileFormat::LAS;
+    if (extension == "xyz" || extension == "txt" || extension == "csv" || extension == "pts") return PointFileFormat::XYZ;
+
+    std::string head(data, std::min<size_t>(size, 4096));
+    if (head.find("\nDATA ") != std::string::npos) return PointFileFormat::PCD;
+    return extension.empty() ? PointFileFormat::XYZ : PointFileFormat::Unknown;
+}
+
+/*
+ * Load
+ *
+ * Single entry point for every supported point format. The file is mapped once and
+ * handed to the decoder DetectFormat picks.
+ */
+PointCloud PLY_loader::Load(const std::string& filepath) {
+    MappedFile file;
+
+    if (!file.Open(filepath)) {
+        std::cerr << "Could not open file: " << filepath << std::endl;
+        return {};
+    }
+
+    PointCloud cloud;
+    switch (DetectFormat(filepath, file.Data(), file.Size())) {
+    case PointFileFormat::PLY: return DecodePLY(file.Data(), file.Size(), filepath);
+    case PointFileFormat::PCD: cloud = DecodePCD(file.Data(), file.Size(), filepath); break;
+    case PointFileFormat::XYZ: cloud = DecodeXYZ(file.Data(), file.Size(), filepath); break;
+    case PointFileFormat::LAS: cloud = DecodeLAS(file.Data(), file.Size(), filepath); break;
+    default:
+        std::cerr << "Unknown point file format: " << filepath << std::endl;
+        return {};
+    }
+
+    cloud.ComputeBounds();
+    return cloud;
+}
+
+PointCloud PLY_loader::DecodePCD(const char* data, size_t size, const std::string& filepath) {
+    PlyHeader header;
+    if (!ParsePcdHeader(data, size, header)) {
+        std::cerr << "Invalid PCD file: " << filepath << std::endl;
+        return {};
+    }
+
+    const char* body = data + header.dataOffset;
+    const char* end = data + size;
+    return header.format == PlyFormat::Ascii ? ExtractAsciiData(body, end, header) : ExtractBinaryData(body, end, header);
+}
+
+PointCloud PLY_loader::DecodeXYZ(const char* data, size_t size, const std::string& filepath) {
+    PlyHeader header;
+    if (!ParseXyzHeader(data, size, header)) {
+        std::cerr << "Invalid XYZ file: " << filepath << std::endl;
+        return {};
+    }
+
+    return ExtractAsciiData(data + header.dataOffset, data + size, header);
+}
+
+/*
+ * DecodeLAS
+ *
+ * Reads uncompressed LAS 1.0 - 1.4 point records in parallel.
+ *
+ *  - Coordinates are stored as int32 and become X * scale + offset (computed in double).
+ *    The center of the header bounds is subtracted in double before the float cast and
+ *    kept as m_origin, absolute UTM coordinates as float would only resolve ~0.5 m
+ *  - Point formats 2, 3, 5, 7, 8 and 10 carry 16 bit RGB. Most writers scale it to
+ *    0..65535, some store 0..255; the range is detected from the maximum value
+ *  - The 16 bit intensity is kept as "intensity" channel, normalized to 0..1
+ *  - LAZ (compressed) files are rejected
+ *
+ */
+PointCloud PLY_loader::DecodeLAS(const char* data, size_t size, const std::string& filepath) {
+    PointCloud cloud;
+
+    if (size < 227 || !StartsWith(data, size, "LASF")) {
+        std::cerr << "Invalid LAS header: " << filepath << std::endl;
+        return cloud;
+    }
+
+    uint16_t headerSize = ReadLE<uint16_t>(data + 94);
+    uint32_t pointOffset = ReadLE<uint32_t>(data + 96);
+    uint8_t pointFormat = ReadLE<uint8_t>(data + 104);
+    uint16_t recordLength = ReadLE<uint16_t>(data + 105);
+    uint64_t pointCount = ReadLE<uint32_t>(data + 107);
+    if (pointCount == 0 && headerSize >= 375 && size >= 255) {
+        pointCount = ReadLE<uint64_t>(data + 247);     // LAS 1.4 64 bit count
+    }
+
+    if (pointFormat & 0xC0) {
+        std::cerr << "Compressed LAS (LAZ) is not supported: " << filepath << std::endl;
+        return cloud;
+    }
+
+    const double scale[3] = { ReadLE<double>(data + 131), ReadLE<double>(data + 139), ReadLE<double>(data + 147) };
+    const double offset[3] = { ReadLE<double>(data + 155), ReadLE<double>(data + 163), ReadLE<double>(data + 171) };
+
+    // header bounds are max x, min x, max y, ...; whole units keep the origin readable, the offset is the fallback
+    double origin[3];
+    for (int axis = 0; axis < 3; axis++) {
+        double high = ReadLE<double>(data + 179 + 16 * axis);
+        double low = ReadLE<double>(data + 187 + 16 * axis);
+        origin[axis] = (std::isfinite(low) && std::isfinite(high) && low <= high) ? std::round(0.5 * (low + high)) : offset[axis];
+    }
+    const size_t colorOffset = LasColorOffset(pointFormat);
+
+    if (recordLength < 12 || (colorOffset > 0 && recordLength < colorOffset + 6) || pointOffset > size) {
+        std::cerr << "Invalid LAS point records: " << filepath << std::endl;
+        return cloud;
+    }
+
+    const char* records = data + pointOffset;
+    size_t available = (size - pointOffset) / recordLength;
+    if (available < pointCount) {
+        std::cerr << "LAS truncated, only " << available << " of " << pointCount << " points available." << std::endl;
+        pointCount = available;
+    }
+
+    const size_t count = static_cast<size_t>(pointCount);
+    cloud.Resize(count);
+    PointArrays out = cloud.Arrays();
+    PointVector<float>& intensity = cloud.AddChannel("intensity", 1).values;
+    std::vector<uint16_t> chunkMaxColor(ChunkCount(count, 1 << 16), 0);
+
+    ParallelFor(count, 1 << 16, [&](size_t first, size_t last, size_t chunk) {
+        uint16_t maxColor = 0;
+        for (size_t i = first; i < last; i++) {
+            const char* record = records + i * recordLength;
+
+            out.ids[i] = static_cast<int>(i);
+            out.positions[i] = glm::vec3(
+                static_cast<float>(ReadLE<int32_t>(record) * scale[0] + offset[0] - origin[0]),
+                static_cast<float>(ReadLE<int32_t>(record + 4) * scale[1] + offset[1] - origin[1]),
+                static_cast<float>(ReadLE<int32_t>(record + 8) * scale[2] + offset[2] - origin[2]));
+            out.normals[i] = glm::vec3(0.0f);
+            intensity[i] = recordLength >= 14 ? ReadLE<uint16_t>(record + 12) / 65535.0f : 0.0f;
+
+            if (colorOffset > 0) {
+                uint16_t r = ReadLE<uint16_t>(record + colorOffset);
+                uint16_t g = ReadLE<uint16_t>(record + colorOffset + 2);
+                uint16_t b = ReadLE<uint16_t>(record + colorOffset + 4);
+                maxColor = std::max({ maxColor, r, g, b });
+                out.colors[i] = glm::vec3(r, g, b) * (1.0f / 65535.0f);
+            }
+            else {
+                out.colors[i] = glm::vec3(1.0f);
+            }
+        }
+        chunkMaxColor[chunk] = maxColor;
+    });
+
+    uint16_t maxColor = chunkMaxColor.empty() ? 0 : *std::max_element(chunkMaxColor.begin(), chunkMaxColor.end());
+    if (colorOffset > 0 && maxColor > 0 && maxColor <= 255) {
+        ParallelFor(count, 1 << 16, [&](size_t first, size_t last, size_t) {
+            for (size_t i = first; i < last; i++) out.colors[i] *= 65535.0f / 255.0f;
+        });
+    }
+
+    cloud.m_hasNormals = false;
+    cloud.m_origin = glm::dvec3(origin[0], origin[1], origin[2]);
+
+    std::cerr << "Loaded (LAS) points: " << cloud.PointsAmount() << std::endl;
+    return cloud;
+}
@@ -0,0 +1,198 @@
+#include "PointGrid.h"
+#include "Parallel.h"
+#include "SpatialOrder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    const int MAX_CELL_COORD = (1 << 21) - 1;
+    const size_t GRID_MIN_CHUNK = 1 << 16;
+
+    uint64_t HashKey(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        return key;
+    }
+}
+
+float PointGrid::SuggestCellSize(PointCloudView cloud, float pointsPerCell) {
+    glm::vec3 extent = cloud.m_boundsMax - cloud.m_boundsMin;
+    float area = extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+    if (cloud.Size() == 0 || !(area > 0.0f)) {
+        // all points on a line or a single spot
+        float length = std::max({ extent.x, extent.y, extent.z });
+        return length > 0.0f && cloud.Size() > 0 ? length * pointsPerCell / float(cloud.Size()) : 1.0f;
+    }
+    float spacing = std::sqrt(area / float(cloud.Size()));
+    return spacing * std::sqrt(std::max(pointsPerCell, 1.0f));
+}
+
+/*
+ * Build
+ *
+ * Keys are computed in parallel, sorted with SpatialOrder::RadixSortOrder and
+ * split into cells where the key changes. Positions are copied in the same
+ * order, so a query scans every cell as one contiguous block no matter how the
+ * cloud itself is ordered. The hash table has at least twice as many slots as
+ * occupied cells.
+ */
+void PointGrid::Build(PointCloudView cloud, float cellSize) {
+    m_origin = cloud.m_boundsMin;
+    m_cellSize = cellSize > 0.0f ? cellSize : 1.0f;
+    m_cellKeys.clear();
+    m_cellStart.clear();
+
+    const size_t count = cloud.Size();
+    std::vector<uint64_t> keys(count);
+    ParallelFor(count, GRID_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+        for (size_t i = first; i < last; i++) {
+            glm::ivec3 cell;
+            CellCoordinate(cloud.m_positions[i], cell);
+            keys[i] = SpatialOrder::MortonKey(uint32_t(cell.x), uint32_t(cell.y), uint32_t(cell.z));
+        }
+    });
+    m_points = SpatialOrder::RadixSortOrder(keys, 63);
+    m_positions.resize(count);
+    ParallelFor(count, GRID_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+        for (size_t k = first; k < last; k++) {
+            m_positions[k] = cloud.m_positions[m_points[k]];
+        }
+    });
+
+    for (size_t k = 0; k < count; k++) {
+        uint64_t key = keys[m_points[k]];
+        if (m_cellKeys.empty() || m_cellKeys.back() != key) {
+            m_cellKeys.push_back(key);
+            m_cellStart.push_back(static_cast<uint32_t>(k));
+        }
+    }
+    m_cellStart.push_back(static_cast<uint32_t>(count));
+
+    size_t tableSize = 16;
+    while (tableSize < 2 * m_cellKeys.size()) tableSize *= 2;
+    m_table.assign(tableSize, -1);
+    m_tableMask = tableSize - 1;
+    for (size_t c = 0; c < m_cellKeys.size(); c++) {
+        uint64_t slot = HashKey(m_cellKeys[c]) & m_tableMask;
+        while (m_table[slot] >= 0) slot = (slot + 1) & m_tableMask;
+        m_table[slot] = static_cast<int32_t>(c);
+    }
+}
+
+void PointGrid::BuildForDensity(PointCloudView cloud, float pointsPerCell) {
+    float cellSize = SuggestCellSize(cloud, pointsPerCell);
+    for (int attempt = 0; attempt < 3; attempt++) {
+        Build(cloud, cellSize);
+        float occupancy = m_cellKeys.empty() ? pointsPerCell : float(cloud.Size()) / float(m_cellKeys.size());
+        if (occupancy < 2.0f * pointsPerCell && occupancy > 0.5f * pointsPerCell) {
+            break;
+        }
+        cellSize *= std::sqrt(pointsPerCell / occupancy);
+    }
+}
+
+// false if position lies outside the grid range, cell is clamped then
+bool PointGrid::CellCoordinate(const glm::vec3& position, glm::ivec3& cell) const {
+    glm::vec3 scaled = (position - m_origin) / m_cellSize;
+    bool inside = true;
+    for (int axis = 0; axis < 3; axis++) {
+        float coordinate = std::floor(scaled[axis]);
+        if (!(coordinate >= 0.0f) || coordinate > float(MAX_CELL_COORD)) inside = false;
+        cell[axis] = static_cast<int>(glm::clamp(coordinate, 0.0f, float(MAX_CELL_COORD)));
+    }
+    return inside;
+}
+
+int PointGrid::FindCell(const glm::ivec3& cell) const {
+    if (cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x > MAX_CELL_COORD || cell.y > MAX_CELL_COORD || cell.z > MAX_CELL_COORD) {
+        return -1;
+    }
+    uint64_t key = SpatialOrder::MortonKey(uint32_t(cell.x), uint32_t(cell.y), uint32_t(cell.z));
+    uint64_t slot = HashKey(key) & m_tableMask;
+    while (m_table[slot] >= 0) {
+        if (m_cellKeys[m_table[slot]] == key) return m_table[slot];
+        slot = (slot + 1) & m_tableMask;
+    }
+    return -1;
+}
+
+/*
+ * KNearest
+ *
+ * result is kept as a max heap on the squared distance while the rings are
+ * searched. After ring r every point closer than r cells plus the distance
+ * of position to the border of its own cell has been seen, so the search ends
+ * once the k-th distance is below that. Cells farther away than the current
+ * k-th neighbour are skipped without a lookup.
+ */
+size_t PointGrid::KNearest(const glm::vec3& position, size_t k, uint32_t exclude, std::vector<Neighbour>& result,
+    int maxRings) const {
+    result.clear();
+    if (k == 0 || m_cellKeys.empty()) {
+        return 0;
+    }
+
+    glm::ivec3 center;
+    bool inside = CellCoordinate(position, center);
+
+    // position inside its own cell in [0, 1], the distance to the nearest face is added to every ring
+    glm::vec3 local = glm::clamp((position - m_origin) / m_cellSize - glm::vec3(center), 0.0f, 1.0f);
+    float margin = inside ? std::min({ local.x, local.y, local.z, 1.0f - local.x, 1.0f - local.y, 1.0f - local.z }) * m_cellSize : 0.0f;
+
+    // squared distance from position to the cell at offset, 0 if position lies outside the grid
+    auto cellDistance2 = [&](const glm::ivec3& offset) {
+        if (!inside) return 0.0f;
+        glm::vec3 gap;
+        for (int axis = 0; axis < 3; axis++) {
+            gap[axis] = offset[axis] > 0 ? offset[axis] - local[axis]
+                : offset[axis] < 0 ? local[axis] - float(offset[axis] + 1) : 0.0f;
+        }
+        return glm::dot(gap, gap) * m_cellSize * m_cellSize;
+    };
+
+    for (int ring = 0; ring <= maxRings; ring++) {
+        for (int dz = -ring; dz <= ring; dz++) {
+            for (int dy = -ring; dy <= ring; dy++) {
+                bool shellYZ = std::abs(dz) == ring || std::abs(dy) == ring;
+                // inside the shell only the two x faces belong to this ring
+                int step = shellYZ ? 1 : std::max(2 * ring, 1);
+                for (int dx = -ring; dx <= ring; dx += step) {
+                    glm::ivec3 offset(dx, dy, dz);
+                    // cells entirely beyond the current k-th neighbour cannot contribute
+                    if (result.size() == k && cellDistance2(offset) >= result.front().first) continue;
+
+                    int cell = FindCell(center + offset);
+                    if (cell < 0) continue;
+
+                    for (uint32_t p = m_cellStart[cell]; p < m_cellStart[cell + 1]; p++) {
+                        uint32_t index = m_points[p];
+                        if (index == exclude) continue;
+
+                        glm::vec3 offset = m_positions[p] - position;
+                        float distance2 = glm::dot(offset, offset);
+                        if (result.size() < k) {
+                            result.emplace_back(distance2, index);
+                            std::push_heap(result.begin(), result.end());
+                        }
+                        else if (distance2 < result.front().first) {
+                            std::pop_heap(result.begin(), result.end());
+                            result.back() = Neighbour(distance2, index);
+                            std::push_heap(result.begin(), result.end());
+                        }
+                    }
+                }
+            }
+        }
+
+        float reach = ring * m_cellSize + margin;
+        if (result.size() == k && result.front().first <= reach * reach) {
+            break;
+        }
+    }
+
+    std::sort_heap(result.begin(), result.end());
+    return result.size();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "PointCloud.h"
+
+/*
+ * PointGrid
+ *
+ * Sparse uniform grid over the positions of a cloud for neighbour queries.
+ * Point indices are sorted by the Morton key of their cell (parallel radix
+ * sort), so every occupied cell is one contiguous range; an open addressing
+ * hash table maps cell keys to ranges. Only occupied cells cost memory, which
+ * keeps fine grids over scanned surfaces small.
+ *
+ * The grid keeps its own copy of the positions in cell order and does not
+ * reference the cloud after Build. Queries are const and can run from many
+ * threads at once.
+ */
+class PointGrid {
+public:
+    // one neighbour: squared distance and point index
+    using Neighbour = std::pair<float, uint32_t>;
+
+    // cell size for about pointsPerCell points per occupied cell, assuming the points sample a surface
+    static float SuggestCellSize(PointCloudView cloud, float pointsPerCell);
+
+    void Build(PointCloudView cloud, float cellSize);
+    // starts from SuggestCellSize and rebuilds while the occupied cells are far off pointsPerCell (noise inflates the bounds)
+    void BuildForDensity(PointCloudView cloud, float pointsPerCell);
+
+    /*
+     * Up to k nearest points of position, nearest first, without the point with index
+     * exclude. Searches rings of cells around position until the k-th neighbour is
+     * provably found or maxRings rings were visited. For isolated points the result
+     * can therefore be approximate or hold fewer than k neighbours.
+     */
+    size_t KNearest(const glm::vec3& position, size_t k, uint32_t exclude, std::vector<Neighbour>& result,
+        int maxRings = 8) const;
+
+    float CellSize() const { return m_cellSize; }
+    size_t CellCount() const { return m_cellKeys.size(); }
+
+private:
+    bool CellCoordinate(const glm::vec3& position, glm::ivec3& cell) const;
+    int FindCell(const glm::ivec3& cell) const;  // -1 if the cell is empty
+
+    glm::vec3 m_origin = glm::vec3(0.0f);
+    float m_cellSize = 1.0f;
+
+    std::vector<uint32_t> m_points;         // point indices, grouped by cell
+    std::vector<glm::vec3> m_positions;     // position of m_points[k] at k
+    std::vector<uint64_t> m_cellKeys;       // Morton key per occupied cell
+    std::vector<uint32_t> m_cellStart;      // points of cell c: m_points[m_cellStart[c], m_cellStart[c + 1])
+    std::vector<int32_t> m_table;           // hash table of cell indices, -1 = empty slot
+    uint64_t m_tableMask = 0;
+};
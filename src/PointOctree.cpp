@@ -0,0 +1,246 @@
+#include "PointOctree.h"
+#include "SpatialOrder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+    // Morton codes have 10 bits per axis, so cells cannot be split below this depth
+    const unsigned MAX_DEPTH = 10;
+
+    // nodes whose representatives are less than this many pixels apart are not refined further
+    const float MIN_SPACING_PIXELS = 1.0f;
+
+    unsigned ChildDigit(uint32_t code, unsigned level) {
+        return (code >> (3 * (MAX_DEPTH - 1 - level))) & 7u;
+    }
+
+    // frustum planes (a, b, c, d) of a projection matrix, the inside satisfies dot(abc, p) + d >= 0
+    void ExtractPlanes(const glm::mat4& m, glm::vec4 planes[6]) {
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+    }
+
+    bool IntersectsFrustum(const glm::vec4 planes[6], const OctreeNode& node) {
+        for (int p = 0; p < 6; p++) {
+            // corner of the box furthest along the plane normal
+            glm::vec3 corner(
+                planes[p].x >= 0.0f ? node.boundsMax.x : node.boundsMin.x,
+                planes[p].y >= 0.0f ? node.boundsMax.y : node.boundsMin.y,
+                planes[p].z >= 0.0f ? node.boundsMax.z : node.boundsMin.z);
+            if (glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+void OctreeSelection::Clear() {
+    nodes.clear();
+    leafFirsts.clear();
+    leafCounts.clear();
+    sampleIndices.clear();
+    points = 0;
+}
+
+void PointOctree::Clear() {
+    m_nodes.clear();
+    m_sampleIndices.clear();
+}
+
+/*
+ * Build
+ *
+ * Recomputes the Morton codes of the sorted cloud and splits the root range by
+ * the next 3 code bits per level with binary searches. The root cell spans 1024
+ * quantization steps per axis, like the codes, so every child cell is exactly
+ * one half of its parent per axis.
+ */
+void PointOctree::Build(PointCloudView cloud, uint32_t leafSize, uint32_t samplesPerNode) {
+    Clear();
+    if (cloud.Size() == 0) {
+        return;
+    }
+
+    m_leafSize = std::max<uint32_t>(leafSize, 1);
+    m_samplesPerNode = std::max<uint32_t>(samplesPerNode, 1);
+
+    std::vector<uint32_t> codes = SpatialOrder::MortonCodes(cloud);
+    if (!std::is_sorted(codes.begin(), codes.end())) {
+        std::cerr << "PointOctree needs a cloud in Morton order." << std::endl;
+        return;
+    }
+
+    OctreeNode root;
+    root.boundsMin = cloud.m_boundsMin;
+    root.boundsMax = cloud.m_boundsMin + (cloud.m_boundsMax - cloud.m_boundsMin) * (1024.0f / 1023.0f);
+    root.first = 0;
+    root.count = static_cast<uint32_t>(cloud.Size());
+    m_nodes.push_back(root);
+
+    BuildNode(0, codes, 0);
+}
+
+void PointOctree::BuildNode(uint32_t index, const std::vector<uint32_t>& codes, unsigned level) {
+    const OctreeNode node = m_nodes[index];
+    if (node.count <= m_leafSize || level >= MAX_DEPTH) {
+        return;
+    }
+
+    // strided representatives, in Morton order they are spread evenly over the cell
+    m_nodes[index].sampleFirst = static_cast<uint32_t>(m_sampleIndices.size());
+    m_nodes[index].sampleCount = std::min(node.count, m_samplesPerNode);
+    for (uint32_t k = 0; k < m_nodes[index].sampleCount; k++) {
+        m_sampleIndices.push_back(node.first + static_cast<uint32_t>(uint64_t(k) * node.count / m_nodes[index].sampleCount));
+    }
+
+    uint32_t childFirst[8];
+    uint32_t childCount[8];
+    uint32_t children = 0;
+    auto begin = codes.begin() + node.first;
+    auto end = begin + node.count;
+    for (unsigned digit = 0; digit < 8; digit++) {
+        auto digitEnd = std::partition_point(begin, end, [&](uint32_t code) { return ChildDigit(code, level) <= digit; });
+        childFirst[digit] = static_cast<uint32_t>(begin - codes.begin());
+        childCount[digit] = static_cast<uint32_t>(digitEnd - begin);
+        if (childCount[digit] > 0) children++;
+        begin = digitEnd;
+    }
+
+    uint32_t firstChild = static_cast<uint32_t>(m_nodes.size());
+    m_nodes[index].firstChild = static_cast<int32_t>(firstChild);
+    m_nodes[index].childCount = children;
+    m_nodes.resize(m_nodes.size() + children);
+
+    const glm::vec3 half = (node.boundsMax - node.boundsMin) * 0.5f;
+    uint32_t child = firstChild;
+    for (unsigned digit = 0; digit < 8; digit++) {
+        if (childCount[digit] == 0) continue;
+
+        OctreeNode& childNode = m_nodes[child];
+        glm::vec3 offset(float(digit & 1u), float((digit >> 1) & 1u), float((digit >> 2) & 1u));
+        childNode.boundsMin = node.boundsMin + offset * half;
+        childNode.boundsMax = childNode.boundsMin + half;
+        childNode.first = childFirst[digit];
+        childNode.count = childCount[digit];
+        child++;
+    }
+
+    for (uint32_t c = firstChild; c < firstChild + children; c++) {
+        BuildNode(c, codes, level + 1);
+    }
+}
+
+// distance between the representatives of a node in pixels, clouds are treated as surfaces
+float PointOctree::ProjectedSpacing(const OctreeNode& node, const glm::vec3& cameraPosition, float pixelsPerRadian) const {
+    if (node.IsLeaf()) {
+        return 0.0f;
+    }
+
+    float spacing = glm::length(node.boundsMax - node.boundsMin) / std::sqrt(float(node.sampleCount));
+    glm::vec3 closest = glm::clamp(cameraPosition, node.boundsMin, node.boundsMax);
+    float distance = glm::length(closest - cameraPosition);
+    if (distance <= 0.0f) {
+        return std::numeric_limits<float>::max();
+    }
+    return spacing / distance * pixelsPerRadian;
+}
+
+/*
+ * Select
+ *
+ * Greedy refinement: the visible node with the largest projected spacing is
+ * replaced by its visible children as long as the budget allows it. Nodes that
+ * can't be refined stay in the selection with their representatives, leaves
+ * with all their points. The selection is only rebuilt if the set of nodes
+ * changed, so the GPU buffers only need an update when the view moved enough.
+ */
+bool PointOctree::Select(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, float pixelsPerRadian,
+    size_t pointBudget, OctreeSelection& selection) {
+    m_selectedNodes.clear();
+    m_queue.clear();
+
+    glm::vec4 planes[6];
+    ExtractPlanes(modelViewProjection, planes);
+
+    auto push = [&](uint32_t index) {
+        m_queue.emplace_back(ProjectedSpacing(m_nodes[index], cameraPosition, pixelsPerRadian), index);
+        std::push_heap(m_queue.begin(), m_queue.end());
+    };
+
+    size_t points = 0;
+    if (!m_nodes.empty() && IntersectsFrustum(planes, m_nodes[0])) {
+        points = DrawCount(m_nodes[0]);
+        push(0);
+    }
+
+    while (!m_queue.empty()) {
+        std::pop_heap(m_queue.begin(), m_queue.end());
+        std::pair<float, uint32_t> next = m_queue.back();
+        m_queue.pop_back();
+
+        const OctreeNode& node = m_nodes[next.second];
+        if (node.IsLeaf() || next.first < MIN_SPACING_PIXELS) {
+            m_selectedNodes.push_back(next.second);
+            continue;
+        }
+
+        size_t childPoints = 0;
+        for (uint32_t c = 0; c < node.childCount; c++) {
+            const OctreeNode& child = m_nodes[node.firstChild + c];
+            if (IntersectsFrustum(planes, child)) childPoints += DrawCount(child);
+        }
+        if (points - DrawCount(node) + childPoints > pointBudget) {
+            m_selectedNodes.push_back(next.second);
+            continue;
+        }
+
+        points = points - DrawCount(node) + childPoints;
+        for (uint32_t c = 0; c < node.childCount; c++) {
+            uint32_t child = node.firstChild + c;
+            if (IntersectsFrustum(planes, m_nodes[child])) push(child);
+        }
+    }
+
+    // the selection is a cut through the tree, so the point ranges of its nodes are disjoint
+    std::sort(m_selectedNodes.begin(), m_selectedNodes.end(), [&](uint32_t a, uint32_t b) {
+        return m_nodes[a].first < m_nodes[b].first;
+    });
+    if (m_selectedNodes == selection.nodes) {
+        return false;
+    }
+
+    selection.Clear();
+    selection.nodes = m_selectedNodes;
+    for (uint32_t index : m_selectedNodes) {
+        const OctreeNode& node = m_nodes[index];
+        if (node.IsLeaf()) {
+            // neighbouring leaves are neighbouring ranges, draw them with one command
+            if (!selection.leafFirsts.empty() && selection.leafFirsts.back() + selection.leafCounts.back() == int32_t(node.first)) {
+                selection.leafCounts.back() += static_cast<int32_t>(node.count);
+            }
+            else {
+                selection.leafFirsts.push_back(static_cast<int32_t>(node.first));
+                selection.leafCounts.push_back(static_cast<int32_t>(node.count));
+            }
+        }
+        else {
+            selection.sampleIndices.insert(selection.sampleIndices.end(),
+                m_sampleIndices.begin() + node.sampleFirst, m_sampleIndices.begin() + node.sampleFirst + node.sampleCount);
+        }
+        selection.points += DrawCount(node);
+    }
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "PointCloud.h"
+
+struct OctreeNode {
+    glm::vec3 boundsMin = glm::vec3(0.0f);     // cell of the node, object space
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    uint32_t first = 0;                         // points [first, first + count) of the cloud lie in the cell
+    uint32_t count = 0;
+    uint32_t sampleFirst = 0;                   // representatives in PointOctree::m_sampleIndices (inner nodes)
+    uint32_t sampleCount = 0;
+    int32_t firstChild = -1;                    // children are stored next to each other, -1 for leaves
+    uint32_t childCount = 0;
+
+    bool IsLeaf() const { return firstChild < 0; }
+};
+
+// nodes picked by PointOctree::Select, ready for glMultiDrawArrays (leaves) and glDrawElements (samples)
+struct OctreeSelection {
+    std::vector<uint32_t> nodes;
+    std::vector<int32_t> leafFirsts;
+    std::vector<int32_t> leafCounts;
+    std::vector<uint32_t> sampleIndices;
+    size_t points = 0;
+
+    void Clear();
+};
+
+/*
+ * PointOctree
+ *
+ * Level of detail hierarchy for displaying clouds that are too large to draw
+ * completely every frame. It is built over a cloud in Morton order
+ * (SpatialOrder::SortMorton), where every octree cell is a contiguous range of
+ * points, so nodes store ranges instead of point lists. Inner nodes keep a
+ * strided subsample of their range as representatives; leaves are drawn with
+ * all their points.
+ *
+ * Select() refines the visible nodes with the largest projected point spacing
+ * first until the point budget is used up. Only the display pass uses the
+ * selection, normals are still computed from the full cloud, which therefore
+ * stays resident on the GPU (see the level of detail notes in Renderer.cpp).
+ */
+class PointOctree {
+public:
+    // cloud must be sorted with SpatialOrder::SortMorton (same bounds)
+    void Build(PointCloudView cloud, uint32_t leafSize = 32768, uint32_t samplesPerNode = 4096);
+    void Clear();
+
+    bool IsEmpty() const { return m_nodes.empty(); }
+
+    // modelViewProjection and cameraPosition are in the object space of the cloud,
+    // pixelsPerRadian = viewport height / field of view. Returns true if the selection changed
+    bool Select(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, float pixelsPerRadian,
+        size_t pointBudget, OctreeSelection& selection);
+
+    size_t NodeCount() const { return m_nodes.size(); }
+
+private:
+    void BuildNode(uint32_t index, const std::vector<uint32_t>& codes, unsigned level);
+    float ProjectedSpacing(const OctreeNode& node, const glm::vec3& cameraPosition, float pixelsPerRadian) const;
+    size_t DrawCount(const OctreeNode& node) const { return node.IsLeaf() ? node.count : node.sampleCount; }
+
+    std::vector<OctreeNode> m_nodes;            // m_nodes[0] is the root
+    std::vector<uint32_t> m_sampleIndices;
+    uint32_t m_leafSize = 0;
+    uint32_t m_samplesPerNode = 0;
+
+    // reused by Select, so selecting does not allocate once the capacity is reached
+    std::vector<std::pair<float, uint32_t>> m_queue;
+    std::vector<uint32_t> m_selectedNodes;
+};
@@ -9,12 +9,82 @@
  * -------------------------------------------------------------------------
  */
 
+#include <chrono>
+#include <future>
 #include <set>
 #include <unordered_map>
 
 #include "Renderer.h"
+#include "NormalEstimation.h"
+#include "OutlierRemoval.h"
+#include "Parallel.h"
+#include "SpatialOrder.h"
+#include "VoxelGrid.h"
 #include "glm/gtx/string_cast.hpp"
 
+namespace {
+
+    const GLsizei MAX_VIEW_LAYERS = 8;     // MAX_VIEWS of the layered shaders
+    const GLuint VIEW_BLOCK_BINDING = 0;   // ViewBlock of the depth, splat and normal passes
+
+    // std140 entry of ViewBlock; 256 bytes, the largest GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT allowed, so every entry can be bound alone
+    struct ViewUniforms {
+        glm::mat4 view;
+        glm::mat4 proj;
+        glm::mat4 invView;
+        glm::mat4 invProj;
+    };
+    static_assert(sizeof(ViewUniforms) == 256, "ViewUniforms must match the std140 ViewBlock");
+    const size_t TIMING_RING_FRAMES = 3;   // frames of query sets in flight before the ring waits for a result
+    const size_t READBACK_SLOTS = 2;       // a recalculation can be issued while the previous copy is in flight
+    const GLuint64 READBACK_WAIT_NS = 1000000000;
+
+    struct TimedLoad {
+        PointCloud cloud;
+        PointCloud source;                      // full resolution cloud if cloud was voxel downsampled
+        std::vector<uint32_t> voxelOfPoint;     // representative in cloud for every point of source
+        double milliseconds = 0.0;
+    };
+
+    // optional CPU stages between loading and upload, in the order they run
+    struct LoadStages {
+        int outlierNeighbours = 0;      // statistical outlier removal, off if 0
+        float outlierStdDev = 2.0f;
+        float voxelSize = 0.0f;         // voxel downsampling, off if 0
+        bool mortonOrder = false;
+    };
+
+    // runs on a worker thread, so it uses its own loader instead of Renderer::plyLoader
+    TimedLoad LoadTimed(const std::string& path, LoadStages stages) {
+        auto begin = std::chrono::steady_clock::now();
+        PLY_loader loader;
+        TimedLoad result;
+        result.cloud = PointCache::Load(path, loader);
+        if (stages.outlierNeighbours > 0) {
+            OutlierOptions options;
+            options.neighbours = stages.outlierNeighbours;
+            options.stdDevMultiplier = stages.outlierStdDev;
+            RemoveStatisticalOutliers(result.cloud, options);
+        }
+        if (stages.voxelSize > 0.0f && result.cloud.Size() > 0) {
+            VoxelDownsample downsampled = VoxelGrid::Downsample(result.cloud, stages.voxelSize);
+            std::cout << "Voxel grid (" << stages.voxelSize << "): " << result.cloud.Size() << " -> "
+                << downsampled.points.Size() << " points" << std::endl;
+            result.source = std::move(result.cloud);
+            result.cloud = std::move(downsampled.points);
+            result.voxelOfPoint = std::move(downsampled.voxelOfPoint);
+        }
+        if (stages.mortonOrder) {
+            std::vector<uint32_t> order = SpatialOrder::SortMorton(result.cloud);
+            if (!result.voxelOfPoint.empty()) {
+                VoxelGrid::RemapVoxels(result.voxelOfPoint, order);
+            }
+        }
+        result.milliseconds = MillisecondsSince(begin);
+        return result;
+    }
+}
+
 Renderer::Renderer(Camera* cam) {
     m_pCamera = cam;
     m_pShaderDepth = nullptr;
@@ -40,12 +110,29 @@ Renderer::~Renderer() {
     delete m_pShaderNormalAvg;
     delete m_pShaderPointsNormals;
     delete m_pShaderNormalCompute;
+    delete m_pShaderLayered;
+    delete m_pShaderCalcNormalLayered;
+    delete m_pShaderNormalAvgLayered;
     delete m_pDebugTexture;
     glDeleteVertexArrays(1, &m_VAO);
     glDeleteBuffers(1, &m_VBO);
     glDeleteVertexArrays(1, &m_lineVAO);
     glDeleteVertexArrays(1, &m_quadVAO);
     glDeleteVertexArrays(1, &m_frustumVAO);
+    for (PassQueries& queries : m_timingRing) {
+        GLuint ids[7] = { queries.ref, queries.splat, queries.accumulate, queries.average, queries.readBack,
+            queries.begin, queries.end };
+        glDeleteQueries(7, ids);
+    }
+    for (GLsync fence : m_readbackFences) {
+        if (fence) glDeleteSync(fence);
+    }
+    glDeleteBuffers(1, &m_viewUBO);
+    glDeleteBuffers(1, &m_lodEBO);
+    if (m_readbackBuffer) {
+        glUnmapNamedBuffer(m_readbackBuffer);
+        glDeleteBuffers(1, &m_readbackBuffer);
+    }
 }
 
 /* -------------------------------------------------------------------------
@@ -56,7 +143,34 @@ Renderer::~Renderer() {
  * -------------------------------------------------------------------------
  */
 void Renderer::Start(std::string ply_path, unsigned int width, unsigned int height) {
+    auto startupBegin = std::chrono::steady_clock::now();
+
+    // take ply_path and replace path with "ground truth" to get reference model from GT folder
+    std::string ply_path_reference = ply_path;
+    std::string term = "no_normals";
+
+    size_t pos = ply_path_reference.find("no_normals");
+
+    if (pos != std::string::npos) {
+        ply_path_reference.replace(pos,term.length(),"ground_truth");
+    }
+
+    // Load both point clouds in the background while this thread does the GL setup.
+    // Without a ground truth folder both paths are equal, then the file is only loaded once
+    bool separateReference = ply_path_reference != ply_path;
+    LoadStages inputStages;
+    inputStages.outlierNeighbours = m_outlierNeighbours;
+    inputStages.outlierStdDev = m_outlierStdDev;
+    inputStages.voxelSize = m_voxelSize;
+    inputStages.mortonOrder = m_mortonOrder || m_useLOD;   // octree nodes are ranges of the Morton order
+    std::future<TimedLoad> pointCloudTask = std::async(std::launch::async, LoadTimed, ply_path, inputStages); // no normal model, to be calculated
+    std::future<TimedLoad> pointCloudGTTask;
+    if (separateReference) {
+        pointCloudGTTask = std::async(std::launch::async, LoadTimed, ply_path_reference, LoadStages()); // ground truth, looked up by ID
+    }
+
     // Load and compile shaders for various render passes
+    auto stageBegin = std::chrono::steady_clock::now();
     m_pShaderDepth = new Shader("src/shaders/depth_pass.vert", "src/shaders/depth_pass.frag");
     m_pShaderBigSplats = new Shader("src/shaders/biggerSplat_pass.vert", "src/shaders/biggerSplat_pass.frag");
     m_pShaderPointsOnly = new Shader("src/shaders/draw_points.vert", "src/shaders/draw_points.frag");
@@ -69,87 +183,179 @@ void Renderer::Start(std::string ply_path, unsigned int width, unsigned int heig
         new Shader("src/shaders/debug/debug_id_tex.vert", "src/shaders/debug/debug_id_tex.frag");
     m_pDrawFrustum = new Shader("src/shaders/draw_frustum.vert", "src/shaders/draw_frustum.frag");
 
+    // gl_Layer from the vertex shader needs GL_ARB_shader_viewport_layer_array, the software raster check reads 2D targets
+    m_layeredActive = m_layeredViews && !m_checkSoftwareRaster;
+    if (m_layeredActive && !GLEW_ARB_shader_viewport_layer_array) {
+        std::cerr << "GL_ARB_shader_viewport_layer_array not supported, rendering the views one by one" << std::endl;
+        m_layeredActive = false;
+    }
+    if (m_layeredActive) {
+        m_pShaderLayered = new Shader("src/shaders/layered_pass.vert", "src/shaders/depth_pass.frag");
+        m_pShaderCalcNormalLayered = new Shader("src/shaders/calc_normal_layered.comp");
+        m_pShaderNormalAvgLayered = new Shader("src/shaders/average_normal_layered.comp");
+    }
+    double shaderMs = MillisecondsSince(stageBegin);
+
     m_width = width;
     m_height = height;
 
-    glGenQueries(1, &qRef);
-    glGenQueries(1, &qSplat);
-    glGenQueries(1, &qAcc);
-    glGenQueries(1, &qFin);
-    glGenQueries(1, &qReadBack);
-    glGenQueries(1, &t0);
-    glGenQueries(1, &t1);
-
-    // take ply_path and replace path with "ground truth" to get reference model from GT folder
-    std::string ply_path_reference = ply_path;
-    std::string term = "no_normals";
-
-    size_t pos = ply_path_reference.find("no_normals");
-
-    if (pos != std::string::npos) {
-        ply_path_reference.replace(pos,term.length(),"ground_truth");
+    stageBegin = std::chrono::steady_clock::now();
+    m_quadVAO = SetupQuadVAO();
+    
+    // for FRUSTUM
+    glm::mat4 projection =
+        glm::perspective(glm::radians(m_pCamera->m_zoom), float(m_width) / float(m_height), m_zNear, m_zFar);
+    m_frustumVAO = SetupFrustumVAO(projection, m_pCamera->GetViewMatrix());
+    
+    ConfigureRefFBO();
+    ConfigureSplatFBO();
+    if (m_layeredActive) {
+        ConfigureLayeredFBO(m_fboRefLayers, m_depthTexRefLayers, m_idTexRefLayers, "Ref");
+        ConfigureLayeredFBO(m_fboSplatLayers, m_depthTexSplatLayers, m_idTexSplatLayers, "Splat");
+    }
+    double targetsMs = MillisecondsSince(stageBegin);
+
+    // Everything below needs the point data
+    stageBegin = std::chrono::steady_clock::now();
+    TimedLoad pointCloudLoad = pointCloudTask.get();
+    TimedLoad pointCloudGTLoad;
+    if (separateReference) {
+        pointCloudGTLoad = pointCloudGTTask.get();
+    }
+    else {
+        // the one intended cloud copy: without a separate reference file the ground truth keeps
+        // the normals of the input (at full resolution) while m_pointCloud receives the computed ones
+        pointCloudGTLoad.cloud = pointCloudLoad.source.Size() > 0 ? pointCloudLoad.source : pointCloudLoad.cloud;
+        pointCloudGTLoad.milliseconds = pointCloudLoad.milliseconds;
     }
- 
+    double waitMs = MillisecondsSince(stageBegin);
 
-    // Load point cloud from PLY file
-    m_pointCloud = plyLoader.LoadPLY(ply_path); // no normal model, to be calculated
-    m_pointCloudGT = plyLoader.LoadPLY(ply_path_reference); // ground truth
+    m_pointCloud = std::move(pointCloudLoad.cloud);
+    m_sourceCloud = std::move(pointCloudLoad.source);
+    m_voxelOfPoint = std::move(pointCloudLoad.voxelOfPoint);
+    m_pointCloudGT = std::move(pointCloudGTLoad.cloud);
     m_pointsAmount = m_pointCloud.PointsAmount();
     m_pointsAmountGT = m_pointCloudGT.PointsAmount();
 
-    if (m_pointsAmount != m_pointsAmountGT) {
+    size_t fullResolution = m_voxelOfPoint.empty() ? m_pointsAmount : m_sourceCloud.Size();
+    if (fullResolution != m_pointsAmountGT) {
         std::cerr << "Warning. Point cloud sizes dont match! \n";
     }
 
+    // CPU baseline: the normals are uploaded with the points and the GPU passes are skipped
+    double cpuNormalsMs = 0.0;
+    bool cpuNormals = m_cpuNormalNeighbours > 0;
+    if (cpuNormals) {
+        stageBegin = std::chrono::steady_clock::now();
+        PCANormalOptions options;
+        options.neighbours = m_cpuNormalNeighbours;
+        EstimateNormalsPCA(m_pointCloud, options);
+        NormalErrorStats error = CompareNormals(m_pointCloud, m_pointCloudGT);
+        std::cout << "CPU normals vs ground truth: mean " << error.meanAngle << " deg, " << error.within5
+            << " within 5 deg, " << error.within30 << " within 30 deg, " << error.above30 << " above" << std::endl;
+        cpuNormalsMs = MillisecondsSince(stageBegin);
+    }
+
+    // views and depth range of the normal passes, fitted to the final cloud
+    double planMs = 0.0;
+    if (m_planViews && !cpuNormals && !m_pointCloud.m_hasNormals) {
+        stageBegin = std::chrono::steady_clock::now();
+        ViewPlanOptions options;
+        options.width = int(m_width);
+        options.height = int(m_height);
+        options.fovY = glm::radians(m_pCamera->m_zoom);
+        options.splatSize = splatSize;
+        options.maxViews = m_layeredActive ? std::min(m_planMaxViews, int(MAX_VIEW_LAYERS)) : m_planMaxViews;
+        options.targetCoverage = m_planCoverage;
+        m_viewPlan = m_viewPlanner.Plan(m_pointCloud, options);
+        planMs = MillisecondsSince(stageBegin);
+    }
+
+    stageBegin = std::chrono::steady_clock::now();
+
+    // the per-view loop takes one query set per view, a plan may have any number of views
+    size_t viewsPerFrame = m_viewPlan.views.empty() ? ScreenSpaceNormals::OrbitViews(glm::mat4(1.0f)).size() : m_viewPlan.views.size();
+    m_timingRing.resize(TIMING_RING_FRAMES * std::max<size_t>(viewsPerFrame, 1));
+    for (PassQueries& queries : m_timingRing) {
+        GLuint ids[7];
+        glGenQueries(7, ids);
+        queries.ref = ids[0];
+        queries.splat = ids[1];
+        queries.accumulate = ids[2];
+        queries.average = ids[3];
+        queries.readBack = ids[4];
+        queries.begin = ids[5];
+        queries.end = ids[6];
+    }
+
     glGenVertexArrays(1, &m_VAO);
     glGenBuffers(1, &m_VBO);
 
     glBindVertexArray(m_VAO);
     glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
 
-    glBufferData(GL_ARRAY_BUFFER, m_pointsAmount * sizeof(Point), m_pointCloud.m_points.data(),
+    // depth and splat pass only read ID and position
+    PointVector<PointVertex> vertices = m_pointCloud.PackVertices();
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(PointVertex), vertices.data(),
         GL_STATIC_DRAW);
 
-    glVertexAttribIPointer(0, 1, GL_INT, sizeof(Point),
-        (void*)offsetof(Point, m_pointID));
+    glVertexAttribIPointer(0, 1, GL_INT, sizeof(PointVertex),
+        (void*)offsetof(PointVertex, m_pointID));
     glEnableVertexAttribArray(0);
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Point),
-        (void*)offsetof(Point, m_position));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(PointVertex),
+        (void*)offsetof(PointVertex, m_position));
     glEnableVertexAttribArray(1);
 
     std::cout << "Rendering " << m_pointsAmount << " points.\n";
-    std::cout << "sizeof(Point): " << sizeof(Point) << std::endl;
+    std::cout << "sizeof(PointVertex): " << sizeof(PointVertex) << ", sizeof(Point): " << sizeof(Point) << std::endl;
 
-    m_lineVAO = SetupLineVAO();
-    m_quadVAO = SetupQuadVAO();
-    
-    // for FRUSTUM
-    glm::mat4 projection =
-        glm::perspective(glm::radians(m_pCamera->m_zoom), float(m_width) / float(m_height), m_zNear, m_zFar);
-    m_frustumVAO = SetupFrustumVAO(projection, m_pCamera->GetViewMatrix());
-    
-    ConfigureRefFBO();
-    ConfigureSplatFBO();
     ConfigureAvgSSBO();
+    ConfigureReadbackBuffer();
     ConfigureNormalSSBO();
     ConfigureGTSSBO();
+
+    // reads from m_pointAvgSSBO, so it can only be set up once the points are uploaded
+    m_lineVAO = SetupLineVAO();
+    double uploadMs = MillisecondsSince(stageBegin);
+
+    stageBegin = std::chrono::steady_clock::now();
+    SetupLOD();
+    double lodMs = MillisecondsSince(stageBegin);
     
     GLint currentFB;
     glGetIntegerv(GL_FRAMEBUFFER_BINDING, &currentFB);
     std::cout << "Current framebuffer: " << currentFB << std::endl;
 
-    if (m_pointCloud.m_hasNormals) {
+    if (cpuNormals) {
+        std::cout << "Normals estimated on the CPU. Skip normal calculation..." << std::endl;
+    }
+    else if (m_pointCloud.m_hasNormals) {
         std::cout << "Normals detected. Skip normal calculation..." << std::endl;
         std::cout << "Expected Normal for ID: " << 200<< " : " << glm::to_string(expectedNormal)
             << std::endl;
     }
+    else if (m_cpuScreenSpace) {
+        std::cout << "No normals detected. Calculating normals on the CPU..." << std::endl;
+    }
     else {
         std::cout << "No normals detected. Calculating normals..." << std::endl;
     }
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
+
+    std::cout << "Startup timings (ms):\n"
+        << "  load point cloud:    " << pointCloudLoad.milliseconds << " (background)\n"
+        << "  load ground truth:   " << pointCloudGTLoad.milliseconds << " (background)\n"
+        << "  compile shaders:     " << shaderMs << "\n"
+        << "  queries, VAOs, FBOs: " << targetsMs << "\n"
+        << "  wait for loads:      " << waitMs << "\n"
+        << "  CPU normals:         " << cpuNormalsMs << "\n"
+        << "  plan views:          " << planMs << "\n"
+        << "  upload VBO, SSBOs:   " << uploadMs << "\n"
+        << "  build octree:        " << lodMs << "\n"
+        << "  total:               " << MillisecondsSince(startupBegin) << std::endl;
 }
 
 /* -------------------------------------------------------------------------
@@ -160,6 +366,15 @@ void Renderer::Start(std::string ply_path, unsigned int width, unsigned int heig
  * -------------------------------------------------------------------------
  */
 void Renderer::Render(float fps) {
+    // per point storage allocated during this frame, expected to stay zero once the first readback is done
+    PointAllocationStats& allocationStats = GetPointAllocationStats();
+    uint64_t allocationsBefore = allocationStats.allocations.load(std::memory_order_relaxed);
+    uint64_t bytesBefore = allocationStats.bytes.load(std::memory_order_relaxed);
+
+    // results of earlier recalculations the GPU has finished by now, never waits
+    CollectTimings();
+    ConsumeReadbacks(false);
+
     glm::mat4 view = m_pCamera->GetViewMatrix();
     glm::mat4 projection =
         glm::perspective(glm::radians(m_pCamera->m_zoom), float(m_width) / float(m_height), m_zNear, m_zFar);
@@ -177,36 +392,64 @@ void Renderer::Render(float fps) {
 
     expectedNormal = m_pointCloud.GetNormalByID(200);
 
-    std::vector<float> cameraAngles = { 0, 45, 90, 135, 180, 225, 270, 315 };
-
     glm::mat4 model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0, 1.0, 0.0));
 
+    // planned views stay fixed to the cloud (their view * model is the planned view), the orbit follows the camera
+    std::vector<glm::mat4> views;
+    glm::mat4 viewsProjection = projection;
+    float viewsNear = m_zNear;
+    float viewsFar = m_zFar;
+    bool followCamera = m_viewPlan.views.empty();
+    if (followCamera) {
+        views = ScreenSpaceNormals::OrbitViews(view);
+    }
+    else {
+        glm::mat4 invModel = glm::inverse(model);
+        for (const glm::mat4& planned : m_viewPlan.views) {
+            views.push_back(planned * invModel);
+        }
+        viewsProjection = m_viewPlan.projection;
+        viewsNear = m_viewPlan.zNear;
+        viewsFar = m_viewPlan.zFar;
+    }
+
     glClearColor(0.141f, 0.149f, 0.192f, 1.0f);
 
     // if its ground truth (point cloud with normals) dont calculate obv
     // Only calculate if "TAB" is pressed (=Recalculate on) to prevent LAG
     
-    if (!m_pointCloud.m_hasNormals && m_recalculate) {
-          for(int i = 0; i < cameraAngles.size(); ++i) {
+    if (!m_pointCloud.m_hasNormals && m_recalculate && m_cpuScreenSpace) {
+        RenderScreenSpaceCPU(views, viewsProjection, model);
+        if (followCamera) view = views.back();
+    }
+    else if (!m_pointCloud.m_hasNormals && m_recalculate && m_layeredActive) {
+        RenderViewsLayered(views, viewsProjection, model);
+        if (followCamera) view = views.back();
+    }
+    else if (!m_pointCloud.m_hasNormals && m_recalculate) {
+          UploadViewUniforms(views, viewsProjection);
+          // the ID attachments are R32I: a glClear with the float clear color leaves them undefined
+          const GLint minusOne[1] = { -1 };
+          for (size_t i = 0; i < views.size(); ++i) {
 
-            glQueryCounter(t0, GL_TIMESTAMP);
+            PassQueries& queries = NextTimingQueries(1);
+            glQueryCounter(queries.begin, GL_TIMESTAMP);
 
 
-            // Prestep: Adjust the view matrix dependent on the current view iteration
-            view = glm::rotate(view, glm::radians(cameraAngles[i]), glm::vec3(0.0f, 1.0f, 0.0f));
+            // Prestep: select the matrices of the current view iteration
+            if (followCamera) view = views[i];
+            glBindBufferRange(GL_UNIFORM_BUFFER, VIEW_BLOCK_BINDING, m_viewUBO, GLintptr(i * sizeof(ViewUniforms)),
+                sizeof(ViewUniforms));
 
             // First pass: render point cloud to fill depth and ID textures (reference textures)
-            glBeginQuery(GL_TIME_ELAPSED, qRef);
+            glBeginQuery(GL_TIME_ELAPSED, queries.ref);
             glBindFramebuffer(GL_FRAMEBUFFER, m_fboRef);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glClearBufferiv(GL_COLOR, 0, minusOne);
             glEnable(GL_DEPTH_TEST);
 
             m_pShaderDepth->Use();  // use depth_pass shader
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderDepth->m_shaderID, "view"), 1, GL_FALSE,
-                glm::value_ptr(view));
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderDepth->m_shaderID, "proj"), 1, GL_FALSE,
-                glm::value_ptr(projection));
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderDepth->m_shaderID, "model"), 1, GL_FALSE,
+            glUniformMatrix4fv(m_pShaderDepth->Uniform("model"), 1, GL_FALSE,
                 glm::value_ptr(model));
 
             glBindVertexArray(m_VAO);
@@ -214,34 +457,37 @@ void Renderer::Render(float fps) {
             glBindVertexArray(0);
             glEndQuery(GL_TIME_ELAPSED);
             glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            if (m_checkSoftwareRaster) {
+                CheckSoftwareRaster(viewsProjection * views[i] * model, 1.0f, m_depthTexRef, m_idTexRef, "reference");
+            }
 
             // Second pass: render point cloud with bigger splats and store to 2 textures (splat textures)
-            glBeginQuery(GL_TIME_ELAPSED, qSplat);
+            glBeginQuery(GL_TIME_ELAPSED, queries.splat);
             glBindFramebuffer(GL_FRAMEBUFFER, m_fboSplat);
             //glDepthMask(GL_FALSE);
             //glDisable(GL_BLEND);
 
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glClearBufferiv(GL_COLOR, 0, minusOne);
             glEnable(GL_DEPTH_TEST);
             
-            m_pShaderBigSplats->Use();  
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderBigSplats->m_shaderID, "view"), 1, GL_FALSE,
-                glm::value_ptr(view));                
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderBigSplats->m_shaderID, "proj"), 1, GL_FALSE,
-                glm::value_ptr(projection));          
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderBigSplats->m_shaderID, "model"), 1, GL_FALSE,
+            m_pShaderBigSplats->Use();
+            glUniformMatrix4fv(m_pShaderBigSplats->Uniform("model"), 1, GL_FALSE,
                 glm::value_ptr(model));
-            glUniform1f(glGetUniformLocation(m_pShaderBigSplats->m_shaderID, "pointSize"), splatSize);
+            glUniform1f(m_pShaderBigSplats->Uniform("pointSize"), splatSize);
             
             glBindVertexArray(m_VAO);
             glDrawArrays(GL_POINTS, 0, m_pointsAmount);
             glBindVertexArray(0);
             glEndQuery(GL_TIME_ELAPSED);
             glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+            if (m_checkSoftwareRaster) {
+                CheckSoftwareRaster(viewsProjection * views[i] * model, splatSize, m_depthTexSplat, m_idTexSplat, "splat");
+            }
 
 
             // Third pass: compute normals from depth buffer, calculate in compute shader 
-            glBeginQuery(GL_TIME_ELAPSED, qAcc);
+            glBeginQuery(GL_TIME_ELAPSED, queries.accumulate);
             glDisable(GL_DEPTH_TEST);
 
             glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
@@ -252,43 +498,36 @@ void Renderer::Render(float fps) {
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, m_depthTexRef);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
-            glUniform1i(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "ref_depth"), 0);
+            glUniform1i(m_pShaderNormalCompute->Uniform("ref_depth"), 0);
 
             glActiveTexture(GL_TEXTURE1);
             glBindTexture(GL_TEXTURE_2D, m_idTexRef);
-            glUniform1i(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "ref_id"), 1);
+            glUniform1i(m_pShaderNormalCompute->Uniform("ref_id"), 1);
 
             // splat textures
 
             glActiveTexture(GL_TEXTURE2);
             glBindTexture(GL_TEXTURE_2D, m_depthTexSplat);
-            glUniform1i(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "splat_depth"), 2);
+            glUniform1i(m_pShaderNormalCompute->Uniform("splat_depth"), 2);
 
             glActiveTexture(GL_TEXTURE3);
             glBindTexture(GL_TEXTURE_2D, m_idTexSplat);
-            glUniform1i(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "splat_id"), 3);
+            glUniform1i(m_pShaderNormalCompute->Uniform("splat_id"), 3);
 
             // other uniforms
 
-            glUniform2i(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "screenSize"), m_width, m_height);
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "view"), 1, GL_FALSE,
-                glm::value_ptr(view));
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "invView"), 1, GL_FALSE,
-                glm::value_ptr(glm::inverse(view)));
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "proj"), 1, GL_FALSE,
-                glm::value_ptr(projection));
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "invProj"), 1,
-                GL_FALSE, glm::value_ptr(glm::inverse(projection)));
-            glUniform1f(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "zNear"), m_zNear);
-            glUniform1f(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "zFar"), m_zFar);
-            glUniform1f(glGetUniformLocation(m_pShaderNormalCompute->m_shaderID, "maxID"), m_pointsAmount);
+            glUniform2i(m_pShaderNormalCompute->Uniform("screenSize"), m_width, m_height);
+            glUniform1f(m_pShaderNormalCompute->Uniform("zNear"), viewsNear);
+            glUniform1f(m_pShaderNormalCompute->Uniform("zFar"), viewsFar);
+            glUniform1f(m_pShaderNormalCompute->Uniform("maxID"), m_pointsAmount);
+            glUniform1i(m_pShaderNormalCompute->Uniform("stencil"), m_normalStencil);
 
 
             // compute shader vars
 
             GLuint workGroupX = (m_width + 7) / 8;
             GLuint workGroupY = (m_height + 7) / 8;
-            glClearNamedBufferData(m_pointNormalSSBO, GL_RGBA32F, GL_RGBA, GL_FLOAT, nullptr);
+            glClearNamedBufferData(m_pointNormalSSBO, GL_RGBA32I, GL_RGBA_INTEGER, GL_INT, nullptr);
             glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_pointNormalSSBO);
 
             glDispatchCompute(workGroupX, workGroupY, 1);
@@ -300,7 +539,7 @@ void Renderer::Render(float fps) {
             glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
             // Fourth Pass: Average the accumulated normals from pass before
-            glBeginQuery(GL_TIME_ELAPSED, qFin);
+            glBeginQuery(GL_TIME_ELAPSED, queries.average);
             glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
             glUseProgram(m_pShaderNormalAvg->m_shaderID);
 
@@ -309,36 +548,28 @@ void Renderer::Render(float fps) {
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, m_depthTexRef);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
-            glUniform1i(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "ref_depth"), 0);
+            glUniform1i(m_pShaderNormalAvg->Uniform("ref_depth"), 0);
 
             glActiveTexture(GL_TEXTURE1);
             glBindTexture(GL_TEXTURE_2D, m_idTexRef);
-            glUniform1i(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "ref_id"), 1);
+            glUniform1i(m_pShaderNormalAvg->Uniform("ref_id"), 1);
 
             // splat textures
 
             glActiveTexture(GL_TEXTURE2);
             glBindTexture(GL_TEXTURE_2D, m_depthTexSplat);
-            glUniform1i(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "splat_depth"), 2);
+            glUniform1i(m_pShaderNormalAvg->Uniform("splat_depth"), 2);
 
             glActiveTexture(GL_TEXTURE3);
             glBindTexture(GL_TEXTURE_2D, m_idTexSplat);
-            glUniform1i(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "splat_id"), 3);
+            glUniform1i(m_pShaderNormalAvg->Uniform("splat_id"), 3);
 
             // other uniforms
 
-            glUniform2i(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "screenSize"), m_width, m_height);
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "view"), 1, GL_FALSE,
-                glm::value_ptr(view));
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "invView"), 1, GL_FALSE,
-                glm::value_ptr(glm::inverse(view)));
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "proj"), 1, GL_FALSE,
-                glm::value_ptr(projection));
-            glUniformMatrix4fv(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "invProj"), 1,
-                GL_FALSE, glm::value_ptr(glm::inverse(projection)));
-            glUniform1f(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "zNear"), m_zNear);
-            glUniform1f(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "zFar"), m_zFar);
-            glUniform1f(glGetUniformLocation(m_pShaderNormalAvg->m_shaderID, "maxID"), m_pointsAmount);
+            glUniform2i(m_pShaderNormalAvg->Uniform("screenSize"), m_width, m_height);
+            glUniform1f(m_pShaderNormalAvg->Uniform("zNear"), viewsNear);
+            glUniform1f(m_pShaderNormalAvg->Uniform("zFar"), viewsFar);
+            glUniform1f(m_pShaderNormalAvg->Uniform("maxID"), m_pointsAmount);
 
             // compute shader vars
             glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_pointNormalSSBO);
@@ -352,54 +583,13 @@ void Renderer::Render(float fps) {
 
             
 
-            std::cout << "-------------(Re)calculating normals for " << m_pointsAmount << " points.-----------------" << std::endl;
-            glBeginQuery(GL_TIME_ELAPSED, qReadBack);
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_pointAvgSSBO);
-            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Point) * m_pointsAmount, m_pointCloud.m_points.data());
-
-            // back to VBO for arrow vis
-            glBindBuffer(GL_COPY_READ_BUFFER, m_pointAvgSSBO);
-            glBindBuffer(GL_COPY_WRITE_BUFFER, m_VBO);
-            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(Point) * m_pointsAmount);
-
-            glEndQuery(GL_TIME_ELAPSED);
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-
-            glQueryCounter(t1, GL_TIMESTAMP);
-
-            Point p = m_pointCloud.m_points[200];
-            std::cout << "Point ID: " << p.m_pointID << std::endl;
-            std::cout << "Position: " << p.m_position.x << ", " << p.m_position.y << ", " << p.m_position.z << std::endl;
-            std::cout << "Normal: " << p.m_normal.x << ", " << p.m_normal.y << ", " << p.m_normal.z << std::endl;
-            std::cout << "sizeof(Point) = " << sizeof(Point) << std::endl;
+            // every averaging pass writes into m_pointAvgSSBO, one readback after the last view has it all
+            if (i + 1 == views.size()) {
+                IssueReadback(queries);
+            }
+            glQueryCounter(queries.end, GL_TIMESTAMP);
             m_pCamera->HasChanged = false;
 
-
-            GLuint64 nsRef = 0, nsSplat = 0, nsAcc = 0, nsAvg = 0, nsRB = 0,  ts0 = 0, ts1 = 0;
-            glGetQueryObjectui64v(qRef, GL_QUERY_RESULT, &nsRef);
-            glGetQueryObjectui64v(qSplat, GL_QUERY_RESULT, &nsSplat);
-            glGetQueryObjectui64v(qAcc, GL_QUERY_RESULT, &nsAcc);
-            glGetQueryObjectui64v(qFin, GL_QUERY_RESULT, &nsAvg);
-            glGetQueryObjectui64v(qReadBack, GL_QUERY_RESULT, &nsRB);
-            glGetQueryObjectui64v(t0, GL_QUERY_RESULT, &ts0);
-            glGetQueryObjectui64v(t1, GL_QUERY_RESULT, &ts1);
-
-            double msRef = nsRef / 1e6;
-            double msSplat = nsSplat / 1e6;
-            double msAcc = nsAcc / 1e6;
-            double msAvg = nsAvg / 1e6;
-            double msRB = nsRB / 1e6;
-            double msTotal = (ts1 - ts0) / 1e6;
-
-
-            std::cout << "Depth Tex  : " << msRef << " ms\n"
-                << "Generate Splats: " << msSplat << " ms\n"
-                << "Accumulate Normals  : " << msAcc << " ms\n"
-                << "Final Averaging  : " << msAvg << " ms\n"
-                << "Normal Calc (Acc + Final): " << msAvg + msAcc << " ms\n"
-                << "Total (no Readback): " << msTotal - msRB << " ms  ->  " << 1000 / (msTotal - msRB) << " FPS\n"
-                << "Readback to VBO for vis: " << msRB << " ms\n";
-
             // m_pointCloud.m_hasNormals = true;
         }
     }
@@ -411,6 +601,10 @@ void Renderer::Render(float fps) {
     glEnable(GL_PROGRAM_POINT_SIZE);
     glEnable(GL_POINT_SMOOTH);
 
+    if (m_lodActive) {
+        UpdateLOD(projection, view * model);
+    }
+
     // for debugging any texture quickly
     if (m_showIDMap == true) {
         m_showPoints = false;
@@ -419,7 +613,7 @@ void Renderer::Render(float fps) {
         glBindTexture(GL_TEXTURE_2D, m_idTexSplat);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glUniform1i(glGetUniformLocation(m_pDebugTexture->m_shaderID, "idTex"), 0);
+        glUniform1i(m_pDebugTexture->Uniform("idTex"), 0);
 
         glDisable(GL_BLEND);           
         glBindVertexArray(m_quadVAO);
@@ -429,35 +623,35 @@ void Renderer::Render(float fps) {
     if (m_showNormals) {
         // draw white points
         m_pShaderPointsOnly->Use();
-        glUniformMatrix4fv(glGetUniformLocation(m_pShaderPointsOnly->m_shaderID, "view"), 1, GL_FALSE,
+        glUniformMatrix4fv(m_pShaderPointsOnly->Uniform("view"), 1, GL_FALSE,
             glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(m_pShaderPointsOnly->m_shaderID, "proj"), 1, GL_FALSE,
+        glUniformMatrix4fv(m_pShaderPointsOnly->Uniform("proj"), 1, GL_FALSE,
             glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(m_pShaderPointsOnly->m_shaderID, "model"), 1, GL_FALSE,
+        glUniformMatrix4fv(m_pShaderPointsOnly->Uniform("model"), 1, GL_FALSE,
             glm::value_ptr(model));
-        glUniform1f(glGetUniformLocation(m_pShaderPointsOnly->m_shaderID, "pointSize"), splatSize);
+        glUniform1f(m_pShaderPointsOnly->Uniform("pointSize"), splatSize);
         glBindVertexArray(m_lineVAO);
-        glDrawArrays(GL_POINTS, 0, m_pointsAmount);
+        DrawDisplayPoints();
 
         // draw normal lines
         m_pShaderPointsNormals->Use();
-        glUniformMatrix4fv(glGetUniformLocation(m_pShaderPointsNormals->m_shaderID, "view"), 1,
+        glUniformMatrix4fv(m_pShaderPointsNormals->Uniform("view"), 1,
             GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(m_pShaderPointsNormals->m_shaderID, "proj"), 1,
+        glUniformMatrix4fv(m_pShaderPointsNormals->Uniform("proj"), 1,
             GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(m_pShaderPointsNormals->m_shaderID, "model"), 1,
+        glUniformMatrix4fv(m_pShaderPointsNormals->Uniform("model"), 1,
             GL_FALSE, glm::value_ptr(model));
         glBindVertexArray(m_lineVAO);
-        glDrawArrays(GL_POINTS, 0, m_pointsAmount);
+        DrawDisplayPoints();
 
         if (m_showFrustum == true) {
             // Show Viewing Frustum
             
             m_pDrawFrustum->Use();
 
-            glUniformMatrix4fv(glGetUniformLocation(m_pDrawFrustum->m_shaderID, "view"), 1, GL_FALSE,
+            glUniformMatrix4fv(m_pDrawFrustum->Uniform("view"), 1, GL_FALSE,
                 glm::value_ptr(view));
-            glUniformMatrix4fv(glGetUniformLocation(m_pDrawFrustum->m_shaderID, "proj"), 1, GL_FALSE,
+            glUniformMatrix4fv(m_pDrawFrustum->Uniform("proj"), 1, GL_FALSE,
                 glm::value_ptr(projection));
             glBindVertexArray(m_frustumVAO);
             glDrawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
@@ -465,32 +659,43 @@ void Renderer::Render(float fps) {
     }
     else if(m_showPoints) {
         m_pShaderPointsOnly->Use();
-        glUniformMatrix4fv(glGetUniformLocation(m_pShaderPointsOnly->m_shaderID, "view"), 1, GL_FALSE,
+        glUniformMatrix4fv(m_pShaderPointsOnly->Uniform("view"), 1, GL_FALSE,
             glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(m_pShaderPointsOnly->m_shaderID, "proj"), 1, GL_FALSE,
+        glUniformMatrix4fv(m_pShaderPointsOnly->Uniform("proj"), 1, GL_FALSE,
             glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(m_pShaderPointsOnly->m_shaderID, "model"), 1, GL_FALSE,
+        glUniformMatrix4fv(m_pShaderPointsOnly->Uniform("model"), 1, GL_FALSE,
             glm::value_ptr(model));
-        glUniform1f(glGetUniformLocation(m_pShaderPointsOnly->m_shaderID, "pointSize"), splatSize);
+        glUniform1f(m_pShaderPointsOnly->Uniform("pointSize"), splatSize);
         glBindVertexArray(m_lineVAO);
-        glDrawArrays(GL_POINTS, 0, m_pointsAmount);
+        DrawDisplayPoints();
     }
     glBindVertexArray(0);
 
     if (saveToPLY) {
-        plyLoader.SavePLY("data/custom/output_data/output.ply", m_pointCloud);
-        std::cout << "Exported ply file! \n";
+        ConsumeReadbacks(true);
+
+        // a downsampled cloud is exported at full resolution, every point gets the normal of its voxel
+        bool downsampled = !m_voxelOfPoint.empty();
+        if (downsampled) {
+            VoxelGrid::ScatterNormals(m_pointCloud, m_voxelOfPoint, m_sourceCloud);
+        }
+        if (plyLoader.SavePLY("data/custom/output_data/output.ply", downsampled ? m_sourceCloud : m_pointCloud)) {
+            std::cout << "Exported ply file! \n";
+        }
         saveToPLY = false;
     }
 
+    m_frameAllocations = allocationStats.allocations.load(std::memory_order_relaxed) - allocationsBefore;
+    m_frameAllocatedBytes = allocationStats.bytes.load(std::memory_order_relaxed) - bytesBefore;
+
     RenderText(fps, m_pointCloud, m_pointCloudGT);
 }
 
-// VAO for the normal lines
+// VAO for the normal lines and colored points, reads the Point layout of m_pointAvgSSBO
 GLuint Renderer::SetupLineVAO() {
     glGenVertexArrays(1, &m_lineVAO);
     glBindVertexArray(m_lineVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_pointAvgSSBO);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Point),
         (void*)offsetof(Point, m_position));
@@ -507,6 +712,84 @@ GLuint Renderer::SetupLineVAO() {
     return m_lineVAO;
 }
 
+/* -------------------------------------------------------------------------
+ * Level of detail
+ *
+ * With m_useLOD (which implies the Morton load stage), clouds above
+ * m_lodPointBudget are displayed through m_octree: leaves are
+ * drawn as ranges of m_lineVAO with glMultiDrawArrays, representatives of inner
+ * nodes through m_lodEBO. The EBO has room for the whole budget and is only
+ * rewritten when the selected nodes change. Depth, splat and normal passes
+ * always use all points.
+ *
+ * The LOD bounds the work of the display pass, not GPU memory. The normal
+ * passes rasterize every point each frame and average_normal.comp writes the
+ * displayed normals into m_pointAvgSSBO, which m_lineVAO draws from, so there
+ * are no display vertices on the CPU that could be streamed into a smaller
+ * buffer. Resident per point: m_VBO (16 B), m_pointNormalSSBO (16 B),
+ * m_pointGTSSBO (16 B) and m_pointAvgSSBO (64 B), at least 112 B or about
+ * 11 GB for 100M points. The LOD adds m_lodEBO (4 B per budget point, 32 MB
+ * at the default budget) plus the octree on the CPU, and caps the display
+ * pass at m_lodPointBudget vertices per frame.
+ * -------------------------------------------------------------------------
+ */
+void Renderer::SetupLOD() {
+    m_lodActive = m_useLOD && m_pointsAmount > m_lodPointBudget;
+    if (!m_lodActive) {
+        if (m_pointsAmount > m_lodPointBudget) {
+            std::cout << "LOD off (m_useLOD not set): all " << m_pointsAmount << " points are drawn, display budget "
+                << m_lodPointBudget << " points.\n";
+        }
+        return;
+    }
+
+    m_octree.Build(m_pointCloud);
+    if (m_octree.IsEmpty()) {
+        std::cout << "LOD off: no octree could be built, all " << m_pointsAmount << " points are drawn.\n";
+        m_lodActive = false;
+        return;
+    }
+
+    glGenBuffers(1, &m_lodEBO);
+    glBindVertexArray(m_lineVAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_lodEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * m_lodPointBudget, nullptr, GL_DYNAMIC_DRAW);
+    glBindVertexArray(0);
+
+    std::cout << "Octree with " << m_octree.NodeCount() << " nodes, display budget " << m_lodPointBudget << " points.\n";
+}
+
+void Renderer::UpdateLOD(const glm::mat4& projection, const glm::mat4& modelView) {
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelView)[3]);
+    float pixelsPerRadian = float(m_height) / glm::radians(m_pCamera->m_zoom);
+
+    if (m_octree.Select(projection * modelView, cameraPosition, pixelsPerRadian, m_lodPointBudget, m_lodSelection)) {
+        size_t samples = std::min(m_lodSelection.sampleIndices.size(), m_lodPointBudget);
+        // the element buffer binding is VAO state, so bind it through the VAO that owns it
+        glBindVertexArray(m_lineVAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_lodEBO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(uint32_t) * samples, m_lodSelection.sampleIndices.data());
+        glBindVertexArray(0);
+    }
+}
+
+// expects m_lineVAO to be bound
+void Renderer::DrawDisplayPoints() {
+    if (!m_lodActive) {
+        glDrawArrays(GL_POINTS, 0, m_pointsAmount);
+        return;
+    }
+
+    if (!m_lodSelection.leafFirsts.empty()) {
+        glMultiDrawArrays(GL_POINTS, m_lodSelection.leafFirsts.data(), m_lodSelection.leafCounts.data(),
+            static_cast<GLsizei>(m_lodSelection.leafFirsts.size()));
+    }
+    size_t samples = std::min(m_lodSelection.sampleIndices.size(), m_lodPointBudget);
+    if (samples > 0) {
+        glDrawElements(GL_POINTS, static_cast<GLsizei>(samples), GL_UNSIGNED_INT, nullptr);
+    }
+}
+
 // VAO for screen quad
 GLuint Renderer::SetupQuadVAO() {
     float quadVertices[] = {
@@ -584,33 +867,383 @@ GLuint Renderer::SetupFrustumVAO(const glm::mat4& projection, const glm::mat4& v
  * -------------------------------------------------------------------------
  */
 
+// accumulation buffer of calc_normal.comp (vec3 sum + counter per point), cleared before every use
 void Renderer::ConfigureNormalSSBO() {
 
     glGenBuffers(1, &m_pointNormalSSBO);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_pointNormalSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Point) * m_pointsAmount, m_pointCloud.m_points.data(), GL_DYNAMIC_DRAW);
+    // fixed point normal sum and counter per point, see NormalBuffer in calc_normal.comp
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::ivec4) * m_pointsAmount, nullptr, GL_DYNAMIC_DRAW);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_pointNormalSSBO);
 
 }
 
+// ground truth normals only, average_normal.comp compares against them.
+// Entry i belongs to point i of m_pointCloud, matched by original ID
 void Renderer::ConfigureGTSSBO() {
 
+    PointVector<glm::vec4> normalsGT = m_pointCloudGT.PackNormalsByID(m_pointCloud.m_ids.data(), m_pointCloud.Size());
     glGenBuffers(1, &m_pointGTSSBO);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_pointGTSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Point) * m_pointsAmountGT, m_pointCloudGT.m_points.data(), GL_DYNAMIC_DRAW);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::vec4) * normalsGT.size(), normalsGT.data(), GL_DYNAMIC_DRAW);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_pointGTSSBO);
-
+    if (m_cpuScreenSpace) {
+        m_normalsGT = std::move(normalsGT);
+    }
 }
 
+// full Point layout: written by average_normal.comp and drawn by the line VAO
 void Renderer::ConfigureAvgSSBO() {
+    PointVector<Point> points = m_pointCloud.PackPoints();
     glGenBuffers(1, &m_pointAvgSSBO);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_pointAvgSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Point) * m_pointsAmount,
-m_pointCloud.m_points.data(), GL_DYNAMIC_DRAW);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Point) * points.size(),
+points.data(), GL_DYNAMIC_DRAW);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_pointAvgSSBO); 
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
+// camera matrices of every view in one upload, the inverses are computed once per view here instead of per pass
+void Renderer::UploadViewUniforms(const std::vector<glm::mat4>& views, const glm::mat4& projection) {
+    size_t capacity = std::max(views.size(), size_t(MAX_VIEW_LAYERS));
+    if (m_viewUniforms.size() < capacity * 4) {
+        m_viewUniforms.resize(capacity * 4);
+        glDeleteBuffers(1, &m_viewUBO);
+        glCreateBuffers(1, &m_viewUBO);
+        glNamedBufferStorage(m_viewUBO, GLsizeiptr(capacity * sizeof(ViewUniforms)), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    glm::mat4 invProjection = glm::inverse(projection);
+    for (size_t i = 0; i < views.size(); ++i) {
+        m_viewUniforms[i * 4 + 0] = views[i];
+        m_viewUniforms[i * 4 + 1] = projection;
+        m_viewUniforms[i * 4 + 2] = glm::inverse(views[i]);
+        m_viewUniforms[i * 4 + 3] = invProjection;
+    }
+    glNamedBufferSubData(m_viewUBO, 0, GLsizeiptr(views.size() * sizeof(ViewUniforms)), m_viewUniforms.data());
+}
+
+/* -------------------------------------------------------------------------
+ * GPU timings and readback
+ *
+ * Nothing in Render waits for the GPU. Every recalculation (every view in the
+ * per-view loop) takes the next set of timer queries from a ring and copies
+ * m_pointAvgSSBO into the next slot of a persistently mapped buffer behind a
+ * fence. At the start of later frames the finished query sets are printed and
+ * the newest finished copy is unpacked into m_pointCloud. Only a ring or slot
+ * that comes around again while still in flight, or an export, blocks.
+ * -------------------------------------------------------------------------
+ */
+Renderer::PassQueries& Renderer::NextTimingQueries(int views) {
+    PassQueries& queries = m_timingRing[m_timingNext];
+    m_timingNext = (m_timingNext + 1) % m_timingRing.size();
+    if (queries.pending) {
+        ReportTimings(queries);
+    }
+    queries.views = views;
+    queries.readBackTimed = false;
+    queries.pending = true;
+    return queries;
+}
+
+void Renderer::CollectTimings() {
+    // oldest first, the GPU finishes them in issue order
+    for (size_t i = 0; i < m_timingRing.size(); ++i) {
+        PassQueries& queries = m_timingRing[(m_timingNext + i) % m_timingRing.size()];
+        if (!queries.pending) continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(queries.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+        ReportTimings(queries);
+    }
+}
+
+void Renderer::ReportTimings(PassQueries& queries) {
+    GLuint64 nsRef = 0, nsSplat = 0, nsAcc = 0, nsAvg = 0, nsRB = 0, ts0 = 0, ts1 = 0;
+    glGetQueryObjectui64v(queries.ref, GL_QUERY_RESULT, &nsRef);
+    glGetQueryObjectui64v(queries.splat, GL_QUERY_RESULT, &nsSplat);
+    glGetQueryObjectui64v(queries.accumulate, GL_QUERY_RESULT, &nsAcc);
+    glGetQueryObjectui64v(queries.average, GL_QUERY_RESULT, &nsAvg);
+    if (queries.readBackTimed) {
+        glGetQueryObjectui64v(queries.readBack, GL_QUERY_RESULT, &nsRB);
+    }
+    glGetQueryObjectui64v(queries.begin, GL_QUERY_RESULT, &ts0);
+    glGetQueryObjectui64v(queries.end, GL_QUERY_RESULT, &ts1);
+    queries.pending = false;
+
+    double msRef = nsRef / 1e6;
+    double msSplat = nsSplat / 1e6;
+    double msAcc = nsAcc / 1e6;
+    double msAvg = nsAvg / 1e6;
+    double msRB = nsRB / 1e6;
+    double msTotal = (ts1 - ts0) / 1e6;
+
+    if (queries.views > 1) {
+        std::cout << "GPU timings of " << queries.views << " layered views:\n";
+    }
+    std::cout << "Depth Tex  : " << msRef << " ms\n"
+        << "Generate Splats: " << msSplat << " ms\n"
+        << "Accumulate Normals  : " << msAcc << " ms\n"
+        << "Final Averaging  : " << msAvg << " ms\n"
+        << "Normal Calc (Acc + Final): " << msAvg + msAcc << " ms\n"
+        << "Total (no Readback): " << msTotal - msRB << " ms  ->  " << 1000 / (msTotal - msRB) << " FPS\n"
+        << "Readback to VBO for vis: " << msRB << " ms\n";
+}
+
+// READBACK_SLOTS copies of m_pointAvgSSBO, mapped once for the lifetime of the renderer
+void Renderer::ConfigureReadbackBuffer() {
+    m_readbackFences.assign(READBACK_SLOTS, nullptr);
+    GLsizeiptr bytes = GLsizeiptr(sizeof(Point) * m_pointsAmount * READBACK_SLOTS);
+    if (bytes == 0) {
+        return;
+    }
+
+    const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &m_readbackBuffer);
+    glNamedBufferStorage(m_readbackBuffer, bytes, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+    m_readbackMapped = static_cast<const Point*>(glMapNamedBufferRange(m_readbackBuffer, 0, bytes, flags));
+    if (!m_readbackMapped) {
+        std::cerr << "Failed to map the readback buffer" << std::endl;
+    }
+}
+
+void Renderer::IssueReadback(PassQueries& queries) {
+    if (!m_readbackMapped) {
+        return;
+    }
+
+    // the slot is still in flight if the GPU is READBACK_SLOTS recalculations behind
+    size_t slot = m_readbackNext;
+    if (m_readbackFences[slot]) {
+        ConsumeReadbacks(true);
+    }
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBeginQuery(GL_TIME_ELAPSED, queries.readBack);
+    GLsizeiptr bytes = GLsizeiptr(sizeof(Point) * m_pointsAmount);
+    glCopyNamedBufferSubData(m_pointAvgSSBO, m_readbackBuffer, 0, bytes * slot, bytes);
+    glEndQuery(GL_TIME_ELAPSED);
+    queries.readBackTimed = true;
+
+    m_readbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_readbackNext = (slot + 1) % READBACK_SLOTS;
+}
+
+// unpacks the newest copy whose fence has signaled, older finished ones are superseded by it
+void Renderer::ConsumeReadbacks(bool wait) {
+    int newest = -1;
+    for (size_t i = 0; i < m_readbackFences.size(); ++i) {
+        size_t slot = (m_readbackNext + i) % m_readbackFences.size();
+        GLsync fence = m_readbackFences[slot];
+        if (!fence) continue;
+
+        GLenum status = wait ? glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, READBACK_WAIT_NS)
+            : glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            if (wait) {
+                std::cerr << "Readback fence not signaled (status " << status << ")" << std::endl;
+            }
+            break;
+        }
+        glDeleteSync(fence);
+        m_readbackFences[slot] = nullptr;
+        newest = static_cast<int>(slot);
+    }
+    if (newest < 0) {
+        return;
+    }
+
+    m_pointCloud.UnpackShading(m_readbackMapped + size_t(newest) * m_pointsAmount, m_pointsAmount);
+
+    Point p = m_pointsAmount > 200 ? m_pointCloud.GetPoint(200) : Point();
+    std::cout << "Point ID: " << p.m_pointID << std::endl;
+    std::cout << "Position: " << p.m_position.x << ", " << p.m_position.y << ", " << p.m_position.z << std::endl;
+    std::cout << "Normal: " << p.m_normal.x << ", " << p.m_normal.y << ", " << p.m_normal.z << std::endl;
+}
+
+/* -------------------------------------------------------------------------
+ * RenderViewsLayered
+ *
+ * All views of Render in one go: the reference and splat passes draw the
+ * cloud once per view as instances into the layers of texture array FBOs,
+ * each compute pass is one dispatch over all layers and the result is read
+ * back once. The normal sums are not cleared between views, so every point
+ * gets the mean over all views it is visible in instead of the last one.
+ * -------------------------------------------------------------------------
+ */
+void Renderer::RenderViewsLayered(const std::vector<glm::mat4>& views, const glm::mat4& projection,
+    const glm::mat4& model) {
+    GLsizei layers = GLsizei(std::min<size_t>(views.size(), MAX_VIEW_LAYERS));
+    UploadViewUniforms(views, projection);
+    glBindBufferRange(GL_UNIFORM_BUFFER, VIEW_BLOCK_BINDING, m_viewUBO, 0, MAX_VIEW_LAYERS * sizeof(ViewUniforms));
+    const GLint minusOne[1] = { -1 };
+
+    PassQueries& queries = NextTimingQueries(layers);
+    glQueryCounter(queries.begin, GL_TIMESTAMP);
+
+    // First pass: depth and ID textures of every view (reference textures)
+    glBeginQuery(GL_TIME_ELAPSED, queries.ref);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboRefLayers);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glClearBufferiv(GL_COLOR, 0, minusOne);
+    glEnable(GL_DEPTH_TEST);
+
+    m_pShaderLayered->Use();
+    glUniformMatrix4fv(m_pShaderLayered->Uniform("model"), 1, GL_FALSE,
+        glm::value_ptr(model));
+    glUniform1f(m_pShaderLayered->Uniform("pointSize"), 1.0f);
+
+    glBindVertexArray(m_VAO);
+    glDrawArraysInstanced(GL_POINTS, 0, m_pointsAmount, layers);
+    glEndQuery(GL_TIME_ELAPSED);
+
+    // Second pass: the same with bigger splats (splat textures)
+    glBeginQuery(GL_TIME_ELAPSED, queries.splat);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboSplatLayers);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glClearBufferiv(GL_COLOR, 0, minusOne);
+
+    glUniform1f(m_pShaderLayered->Uniform("pointSize"), splatSize);
+    glDrawArraysInstanced(GL_POINTS, 0, m_pointsAmount, layers);
+    glBindVertexArray(0);
+    glEndQuery(GL_TIME_ELAPSED);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+    // Third pass: accumulate the normals of all layers
+    glBeginQuery(GL_TIME_ELAPSED, queries.accumulate);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(m_pShaderCalcNormalLayered->m_shaderID);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthTexSplatLayers);
+    glUniform1i(m_pShaderCalcNormalLayered->Uniform("splat_depth"), 0);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_idTexSplatLayers);
+    glUniform1i(m_pShaderCalcNormalLayered->Uniform("splat_id"), 1);
+
+    glUniform2i(m_pShaderCalcNormalLayered->Uniform("screenSize"), m_width, m_height);
+    glUniform1i(m_pShaderCalcNormalLayered->Uniform("stencil"), m_normalStencil);
+
+    GLuint workGroupX = (m_width + 7) / 8;
+    GLuint workGroupY = (m_height + 7) / 8;
+    glClearNamedBufferData(m_pointNormalSSBO, GL_RGBA32I, GL_RGBA_INTEGER, GL_INT, nullptr);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_pointNormalSSBO);
+
+    glDispatchCompute(workGroupX, workGroupY, layers);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glEndQuery(GL_TIME_ELAPSED);
+
+    // Fourth pass: average every point visible in one of the reference layers
+    glBeginQuery(GL_TIME_ELAPSED, queries.average);
+    glUseProgram(m_pShaderNormalAvgLayered->m_shaderID);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_idTexRefLayers);
+    glUniform1i(m_pShaderNormalAvgLayered->Uniform("ref_id"), 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_pointNormalSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_pointGTSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_pointAvgSSBO);
+
+    glDispatchCompute(workGroupX, workGroupY, layers);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glEndQuery(GL_TIME_ELAPSED);
+
+    std::cout << "-------------(Re)calculating normals for " << m_pointsAmount << " points in " << layers
+        << " layered views.-----------------" << std::endl;
+    IssueReadback(queries);
+    glQueryCounter(queries.end, GL_TIMESTAMP);
+
+    // the ID map debug view shows the splat IDs of the last view, like after the per-view loop
+    if (m_showIDMap) {
+        glCopyImageSubData(m_idTexSplatLayers, GL_TEXTURE_2D_ARRAY, 0, 0, 0, layers - 1,
+            m_idTexSplat, GL_TEXTURE_2D, 0, 0, 0, 0, m_width, m_height, 1);
+    }
+    m_pCamera->HasChanged = false;
+}
+
+/* -------------------------------------------------------------------------
+ * RenderScreenSpaceCPU
+ *
+ * The views and passes of the GPU loop in Render, computed by
+ * ScreenSpaceNormals. The result is uploaded to m_pointAvgSSBO, so the display
+ * and line passes work the same for both paths.
+ * -------------------------------------------------------------------------
+ */
+void Renderer::RenderScreenSpaceCPU(const std::vector<glm::mat4>& views, const glm::mat4& projection,
+    const glm::mat4& model) {
+    std::cout << "-------------(Re)calculating normals for " << m_pointsAmount << " points on the CPU.-----------------" << std::endl;
+    if (m_layeredViews) {
+        auto begin = std::chrono::steady_clock::now();
+        m_screenSpaceNormals.ComputeViews(m_pointCloud, m_normalsGT.data(), model, views, projection, splatSize,
+            int(m_width), int(m_height));
+        std::cout << "All views (raster, accumulate, average): " << MillisecondsSince(begin) << " ms\n";
+    }
+    else {
+        for (size_t i = 0; i < views.size(); ++i) {
+            auto begin = std::chrono::steady_clock::now();
+            m_screenSpaceNormals.ComputeView(m_pointCloud, m_normalsGT.data(), model, views[i], projection, splatSize,
+                int(m_width), int(m_height));
+            std::cout << "View " << i << " (raster, accumulate, average): " << MillisecondsSince(begin) << " ms\n";
+        }
+    }
+
+    // the first upload packs the whole layout, later ones only refresh normals and colors
+    auto begin = std::chrono::steady_clock::now();
+    if (m_readbackPoints.size() != m_pointCloud.Size()) {
+        m_readbackPoints = m_pointCloud.PackPoints();
+    }
+    else {
+        m_pointCloud.PackShading(m_readbackPoints.data(), m_readbackPoints.size());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_pointAvgSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Point) * m_readbackPoints.size(), m_readbackPoints.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    std::cout << "Upload for vis: " << MillisecondsSince(begin) << " ms" << std::endl;
+
+    m_pCamera->HasChanged = false;
+}
+
+/* -------------------------------------------------------------------------
+ * CheckSoftwareRaster
+ *
+ * Reads the depth and ID textures of a pass back and compares them with the
+ * SoftwareRasterizer result for the same matrices. Both clear the IDs to -1,
+ * so every pixel is compared. Differences are printed, nothing is changed.
+ * -------------------------------------------------------------------------
+ */
+void Renderer::CheckSoftwareRaster(const glm::mat4& mvp, float pointSize, GLuint depthTex, GLuint idTex, const char* pass) {
+    m_rasterTarget.Resize(m_width, m_height);
+    m_rasterTarget.Clear();
+    m_rasterizer.DrawPoints(m_pointCloud, mvp, pointSize, m_rasterTarget);
+
+    const size_t pixels = size_t(m_width) * m_height;
+    m_glDepthReadback.resize(pixels);
+    m_glIDReadback.resize(pixels);
+    glGetTextureImage(depthTex, 0, GL_DEPTH_COMPONENT, GL_FLOAT, GLsizei(pixels * sizeof(float)), m_glDepthReadback.data());
+    glGetTextureImage(idTex, 0, GL_RED_INTEGER, GL_INT, GLsizei(pixels * sizeof(int)), m_glIDReadback.data());
+
+    size_t covered = 0, coverageMismatches = 0, idMismatches = 0;
+    float maxDepthError = 0.0f;
+    for (size_t p = 0; p < pixels; p++) {
+        bool coveredGL = m_glDepthReadback[p] < 1.0f;
+        bool coveredCPU = m_rasterTarget.depth[p] < 1.0f;
+        if (m_glIDReadback[p] != m_rasterTarget.ids[p]) idMismatches++;
+        if (coveredGL != coveredCPU) {
+            coverageMismatches++;
+        }
+        else if (coveredGL) {
+            covered++;
+            maxDepthError = std::max(maxDepthError, std::abs(m_glDepthReadback[p] - m_rasterTarget.depth[p]));
+        }
+    }
+
+    std::cout << "Software raster check (" << pass << "): " << covered << " pixels covered, " << coverageMismatches
+        << " coverage mismatches, " << idMismatches << " ID mismatches, max depth difference " << maxDepthError << std::endl;
+}
+
 /* -------------------------------------------------------------------------
  * configureFBO
  *
@@ -661,6 +1294,42 @@ void Renderer::ConfigureRefFBO() {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+// GL_TEXTURE_2D_ARRAY targets with MAX_VIEW_LAYERS layers, the whole array is attached so gl_Layer selects the view
+void Renderer::ConfigureLayeredFBO(GLuint& fbo, GLuint& depthTex, GLuint& idTex, const char* name) {
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    glGenTextures(1, &depthTex);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTex);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32, m_width, m_height, MAX_VIEW_LAYERS);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTex, 0);
+
+    glGenTextures(1, &idTex);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, idTex);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R32I, m_width, m_height, MAX_VIEW_LAYERS);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, idTex, 0);
+
+    GLenum attachments[1] = { GL_COLOR_ATTACHMENT0 };
+    glDrawBuffers(1, attachments);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status == GL_FRAMEBUFFER_COMPLETE) {
+        printf("%s layered FBO complete!\n", name);
+    }
+    else {
+        printf("%s layered FBO incomplete! Error: %d\n", name, status);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
 void Renderer::ConfigureSplatFBO() {
     glGenFramebuffers(1, &m_fboSplat);
     glBindFramebuffer(GL_FRAMEBUFFER, m_fboSplat);
@@ -715,7 +1384,7 @@ void Renderer::ConfigureSplatFBO() {
  */
 
 
-void Renderer::RenderText(float fps, PointCloud pc, PointCloud pcGT ) {
+void Renderer::RenderText(float fps, PointCloudView pc, PointCloudView pcGT) {
     glUseProgram(0);
 
     // Set up orthographic projection for 2D screen-space rendering (e.g., text)
@@ -728,7 +1397,9 @@ void Renderer::RenderText(float fps, PointCloud pc, PointCloud pcGT ) {
 
     ss << "FPS: " << fps
         << "\nPoints: " << m_pointsAmount
+        << "\nDisplayed: " << (m_lodActive ? m_lodSelection.points : m_pointsAmount) << (m_lodActive ? " (LOD)" : "")
         << "\nSplat Size: " << splatSize
+        << "\nPoint allocations (frame): " << m_frameAllocations << " (" << m_frameAllocatedBytes << " bytes)"
         << "\nNormal (Point 200): " << glm::to_string(pc.GetNormalByID(200))
         << "\nExpected (Point 200): " << glm::to_string(pcGT.GetNormalByID(200));
     std::string text = ss.str();
@@ -3,6 +3,11 @@
 #include "Camera.h"
 #include "Shader.h" 
 #include "PLY_loader.h"
+#include "PointCache.h"
+#include "PointOctree.h"
+#include "ScreenSpaceNormals.h"
+#include "SoftwareRasterizer.h"
+#include "ViewPlanner.h"
 
 #define  STB_EASY_FONT_IMPLEMENTATION
 #include "stb_easy_font.h"
@@ -15,8 +20,6 @@ public:
          void Start(std::string ply_path, unsigned int width, unsigned int height);
          void Render(float fps);
 
-         GLuint qTotal, qRef, qAcc, qFin, qSplat , qReadBack, t0, t1; //performance query metrics
-
          bool m_showNormals = false;
          bool m_showPoints = true;
          bool m_showDepthOnly = false;
@@ -26,6 +29,20 @@ public:
          bool m_spinPointCloudRight = false;
          bool m_spinPointCloudLeft = false;
          bool saveToPLY = false;
+         bool m_mortonOrder = false;     // opt-in: sort the input cloud along a Morton curve at load time, implied by m_useLOD (set before Start)
+         int m_outlierNeighbours = 0;    // > 0: statistical outlier removal over this many neighbours at load time (set before Start)
+         float m_outlierStdDev = 2.0f;   // outlier threshold in standard deviations of the mean neighbour distance
+         float m_voxelSize = 0.0f;       // > 0: replace the input by one point per voxel of this size before upload (set before Start)
+         int m_cpuNormalNeighbours = 0;  // > 0: estimate normals on the CPU (k-NN PCA) at load instead of the GPU passes (set before Start)
+         bool m_layeredViews = false;    // opt-in: all views in one layered draw / dispatch per pass; normals are averaged over all views instead of the last view deciding (set before Start)
+         bool m_cpuScreenSpace = false;  // run the depth, splat and normal passes of every view on the CPU (ScreenSpaceNormals, set before Start)
+         bool m_planViews = false;       // opt-in: views and depth range of the normal passes from ViewPlanner, fixed to the cloud instead of orbiting the camera (set before Start)
+         int m_planMaxViews = 8;         // view budget of the planner, at most MAX_VIEW_LAYERS on the layered path
+         float m_planCoverage = 0.99f;   // the planner stops once this share of the points is covered
+         int m_normalStencil = 0;        // neighbours of the GPU normal passes: 0 cross, 1 eight-neighbour triangle fan (the CPU path always uses the cross)
+         bool m_checkSoftwareRaster = false;   // compare the GL depth and ID passes with SoftwareRasterizer after every view (slow, for driver issues)
+         bool m_useLOD = false;          // opt-in: display clouds above m_lodPointBudget through the octree, sorts the cloud like m_mortonOrder (set before Start)
+         size_t m_lodPointBudget = 8000000;  // points drawn per frame by the display pass when the LOD is active (bounds draw work, the full cloud stays on the GPU)
 
          GLuint m_fboRef = 0;
          GLuint m_depthTexRef = 0;
@@ -35,6 +52,15 @@ public:
          GLuint m_depthTexSplat = 0;
          GLuint m_idTexSplat = 0;
 
+         // texture array versions for m_layeredViews, one layer per view
+         GLuint m_fboRefLayers = 0;
+         GLuint m_depthTexRefLayers = 0;
+         GLuint m_idTexRefLayers = 0;
+
+         GLuint m_fboSplatLayers = 0;
+         GLuint m_depthTexSplatLayers = 0;
+         GLuint m_idTexSplatLayers = 0;
+
          glm::vec3 expectedNormal;
 
          size_t m_pointsAmount = 0;
@@ -51,6 +77,8 @@ private:
 
          PointCloud m_pointCloud;
          PointCloud m_pointCloudGT; // ground truth
+         PointCloud m_sourceCloud;  // full resolution input, only kept if m_pointCloud is voxel downsampled
+         std::vector<uint32_t> m_voxelOfPoint;  // m_pointCloud index for every point of m_sourceCloud
 
          unsigned int m_height;
          unsigned int m_width;
@@ -61,6 +89,9 @@ private:
          Shader* m_pShaderCalcNormal = nullptr;
          Shader* m_pShaderNormalAvg = nullptr;
          Shader* m_pShaderNormalCompute = nullptr;
+         Shader* m_pShaderLayered = nullptr;
+         Shader* m_pShaderCalcNormalLayered = nullptr;
+         Shader* m_pShaderNormalAvgLayered = nullptr;
          Shader* m_pShaderPointsNormals = nullptr;
          Shader* m_pDebugTexture = nullptr;
          Shader* m_pDebugNormalTexture = nullptr;
@@ -75,18 +106,73 @@ private:
          GLuint m_pointGTSSBO;
          GLuint m_pointAvgSSBO;
 
+         PointVector<Point> m_readbackPoints;    // staging for the m_pointAvgSSBO upload of m_cpuScreenSpace, reused every frame
+
+         GLuint m_viewUBO = 0;                   // ViewBlock entries of all views, see UploadViewUniforms
+         std::vector<glm::mat4> m_viewUniforms;  // staging: view, proj, invView, invProj per view
+
+         // GPU timer queries of one recalculation (one view in the per-view loop), collected once available
+         struct PassQueries {
+             GLuint ref = 0, splat = 0, accumulate = 0, average = 0, readBack = 0, begin = 0, end = 0;
+             int views = 0;
+             bool readBackTimed = false;         // readBack was issued for this set
+             bool pending = false;
+         };
+         std::vector<PassQueries> m_timingRing;
+         size_t m_timingNext = 0;
+
+         // copies of m_pointAvgSSBO in a persistently mapped buffer, unpacked once their fence signaled
+         GLuint m_readbackBuffer = 0;
+         const Point* m_readbackMapped = nullptr;
+         std::vector<GLsync> m_readbackFences;
+         size_t m_readbackNext = 0;
+
+         PointOctree m_octree;
+         OctreeSelection m_lodSelection;
+         GLuint m_lodEBO = 0;                    // sample indices of the selected inner nodes, m_lodPointBudget entries
+         bool m_lodActive = false;
+         bool m_layeredActive = false;           // m_layeredViews and the GL side supports it
+
+         ViewPlanner m_viewPlanner;
+         ViewPlan m_viewPlan;                    // empty: the normal passes use ScreenSpaceNormals::OrbitViews
+
+         ScreenSpaceNormals m_screenSpaceNormals;
+         PointVector<glm::vec4> m_normalsGT;     // ground truth per point for m_cpuScreenSpace, same content as m_pointGTSSBO
+
+         SoftwareRasterizer m_rasterizer;
+         RasterTarget m_rasterTarget;
+         std::vector<float> m_glDepthReadback;   // GL side of CheckSoftwareRaster
+         std::vector<int> m_glIDReadback;
+
+         uint64_t m_frameAllocations = 0;        // PointAllocationStats delta of the last frame
+         uint64_t m_frameAllocatedBytes = 0;
+
 private:
          void ConfigureNormalSSBO();
          void ConfigureGTSSBO();
          void ConfigureAvgSSBO();
+         void ConfigureReadbackBuffer();
          void ConfigureRefFBO();
          void ConfigureSplatFBO();
          void ConfigureFBO(GLuint& fbo, GLuint& depthTex, GLuint& idTex);
+         void ConfigureLayeredFBO(GLuint& fbo, GLuint& depthTex, GLuint& idTex, const char* name);
          GLuint SetupLineVAO();
          GLuint SetupQuadVAO();
          GLuint SetupFrustumVAO(const glm::mat4& projection, const glm::mat4& view);
-
-         void RenderText(float fps, PointCloud pc, PointCloud pcGT);
+         void SetupLOD();
+         void UpdateLOD(const glm::mat4& projection, const glm::mat4& modelView);
+         void DrawDisplayPoints();
+         void UploadViewUniforms(const std::vector<glm::mat4>& views, const glm::mat4& projection);
+         PassQueries& NextTimingQueries(int views);
+         void CollectTimings();
+         void ReportTimings(PassQueries& queries);
+         void IssueReadback(PassQueries& queries);
+         void ConsumeReadbacks(bool wait);
+         void RenderViewsLayered(const std::vector<glm::mat4>& views, const glm::mat4& projection, const glm::mat4& model);
+         void RenderScreenSpaceCPU(const std::vector<glm::mat4>& views, const glm::mat4& projection, const glm::mat4& model);
+         void CheckSoftwareRaster(const glm::mat4& mvp, float pointSize, GLuint depthTex, GLuint idTex, const char* pass);
+
+         void RenderText(float fps, PointCloudView pc, PointCloudView pcGT);
 
          float angle;
 
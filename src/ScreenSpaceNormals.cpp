@@ -0,0 +1,180 @@
+#include "ScreenSpaceNormals.h"
+#include "NormalEstimation.h"
+#include "Parallel.h"
+#include "SpatialOrder.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+    const size_t SCREEN_MIN_ROWS = 16;
+    const size_t SCREEN_MIN_CHUNK = 1 << 15;
+
+    // getPos of calc_normal.comp: view space position of a pixel center at a window depth
+    glm::vec3 ViewPosition(const glm::mat4& invProjection, const glm::vec2& screenSize, int x, int y, float depth) {
+        glm::vec2 ndc = ((glm::vec2(float(x), float(y)) + 0.5f) / screenSize) * 2.0f - 1.0f;
+        glm::vec4 viewSpace = invProjection * glm::vec4(ndc, depth * 2.0f - 1.0f, 1.0f);
+        return glm::vec3(viewSpace) / viewSpace.w;
+    }
+
+    // bits needed for the keys 0 .. points (the point count marks pixels without a normal)
+    unsigned KeyBits(size_t points) {
+        unsigned bits = 1;
+        while (bits < 32 && (size_t(1) << bits) <= points) bits++;
+        return bits;
+    }
+}
+
+void ScreenSpaceNormals::ComputeView(PointCloud& cloud, const glm::vec4* normalsGT, const glm::mat4& model,
+    const glm::mat4& view, const glm::mat4& projection, float splatSize, int width, int height) {
+    ComputeViews(cloud, normalsGT, model, std::vector<glm::mat4>(1, view), projection, splatSize, width, height);
+}
+
+void ScreenSpaceNormals::ComputeViews(PointCloud& cloud, const glm::vec4* normalsGT, const glm::mat4& model,
+    const std::vector<glm::mat4>& views, const glm::mat4& projection, float splatSize, int width, int height) {
+    m_reference.Resize(width, height);
+    m_splat.Resize(width, height);
+    Reset(cloud.Size());
+
+    for (const glm::mat4& view : views) {
+        m_reference.Clear();
+        m_splat.Clear();
+        glm::mat4 mvp = projection * view * model;
+        m_rasterizer.DrawPoints(cloud, mvp, 1.0f, m_reference);
+        m_rasterizer.DrawPoints(cloud, mvp, splatSize, m_splat);
+
+        Accumulate(m_splat, view, projection);
+        MarkVisible(m_reference);
+    }
+    Average(normalsGT, cloud);
+}
+
+void ScreenSpaceNormals::Reset(size_t points) {
+    m_sums.resize(points);
+    m_counts.resize(points);
+    m_visible.resize(points);
+    ParallelFor(points, SCREEN_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+        std::fill(m_sums.begin() + first, m_sums.begin() + last, glm::vec3(0.0f));
+        std::fill(m_counts.begin() + first, m_counts.begin() + last, 0);
+        std::fill(m_visible.begin() + first, m_visible.begin() + last, uint8_t(0));
+    });
+}
+
+void ScreenSpaceNormals::Accumulate(const RasterTarget& splat, const glm::mat4& view, const glm::mat4& projection) {
+    const size_t points = m_sums.size();
+    const int width = splat.width;
+    const int height = splat.height;
+    const size_t pixels = size_t(width) * height;
+    const uint32_t none = static_cast<uint32_t>(points);
+    const glm::mat4 invProjection = glm::inverse(projection);
+    const glm::mat3 invView = glm::mat3(glm::inverse(view));
+    const glm::vec2 screenSize = glm::vec2(float(width), float(height));
+
+    m_pixelNormals.resize(pixels);
+    m_pixelKeys.resize(pixels);
+    ParallelFor(size_t(height), SCREEN_MIN_ROWS, [&](size_t firstRow, size_t lastRow, size_t) {
+        for (int y = int(firstRow); y < int(lastRow); y++) {
+            for (int x = 0; x < width; x++) {
+                size_t p = size_t(y) * width + x;
+                m_pixelKeys[p] = none;
+
+                int id = splat.ids[p];
+                if (x <= 0 || y <= 0 || x >= width - 1 || y >= height - 1 || id < 0 || size_t(id) >= points) {
+                    continue;
+                }
+
+                glm::vec3 left = ViewPosition(invProjection, screenSize, x - 1, y, splat.depth[p - 1]);
+                glm::vec3 right = ViewPosition(invProjection, screenSize, x + 1, y, splat.depth[p + 1]);
+                glm::vec3 down = ViewPosition(invProjection, screenSize, x, y - 1, splat.depth[p - width]);
+                glm::vec3 up = ViewPosition(invProjection, screenSize, x, y + 1, splat.depth[p + width]);
+
+                glm::vec3 normal = glm::cross(right - left, up - down);
+                float length2 = glm::dot(normal, normal);
+                if (!(length2 > 0.0f) || !std::isfinite(length2)) {
+                    continue;
+                }
+                m_pixelNormals[p] = glm::normalize(invView * (normal / std::sqrt(length2)));
+                m_pixelKeys[p] = static_cast<uint32_t>(id);
+            }
+        }
+    });
+
+    // stable: pixels of one ID stay in pixel order, pixels without a normal end up behind all IDs
+    m_order = SpatialOrder::RadixSortOrder(m_pixelKeys, KeyBits(points));
+    const size_t valid = std::partition_point(m_order.begin(), m_order.end(),
+        [&](uint32_t pixel) { return m_pixelKeys[pixel] < none; }) - m_order.begin();
+
+    // a chunk sums every ID that starts inside it, to the end of the ID
+    ParallelFor(valid, SCREEN_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+        size_t i = first;
+        if (first > 0) {
+            uint32_t previous = m_pixelKeys[m_order[first - 1]];
+            while (i < last && m_pixelKeys[m_order[i]] == previous) i++;
+        }
+        while (i < last) {
+            uint32_t id = m_pixelKeys[m_order[i]];
+            glm::vec3 sum(0.0f);
+            int count = 0;
+            for (; i < valid && m_pixelKeys[m_order[i]] == id; i++) {
+                sum += m_pixelNormals[m_order[i]];
+                count++;
+            }
+            m_sums[id] += sum;
+            m_counts[id] += count;
+        }
+    });
+}
+
+void ScreenSpaceNormals::MarkVisible(const RasterTarget& reference) {
+    const size_t points = m_visible.size();
+    const size_t pixels = size_t(reference.width) * reference.height;
+
+    // a 1 px point covers a single pixel, so no two pixels write the same flag
+    ParallelFor(pixels, SCREEN_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+        for (size_t p = first; p < last; p++) {
+            int id = reference.ids[p];
+            if (id >= 0 && size_t(id) < points) {
+                m_visible[id] = 1;
+            }
+        }
+    });
+}
+
+void ScreenSpaceNormals::Average(const glm::vec4* normalsGT, PointCloud& cloud) const {
+    const size_t points = std::min(cloud.Size(), m_visible.size());
+
+    ParallelFor(points, SCREEN_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+        for (size_t i = first; i < last; i++) {
+            if (!m_visible[i]) {
+                continue;
+            }
+
+            glm::vec3 mean = m_counts[i] > 0 ? m_sums[i] / float(m_counts[i]) : glm::vec3(0.0f);
+            float length2 = glm::dot(mean, mean);
+            if (!(length2 > 0.0f)) {
+                cloud.m_normals[i] = glm::vec3(0.0f);
+                cloud.m_colors[i] = NormalErrorColor(NormalErrorClass::Invalid);
+                continue;
+            }
+
+            glm::vec3 normal = mean / std::sqrt(length2);
+            cloud.m_normals[i] = normal;
+            cloud.m_colors[i] = NormalErrorColor(ClassifyNormalError(NormalErrorAngle(normal, glm::vec3(normalsGT[i]))));
+        }
+    });
+}
+
+std::vector<glm::mat4> ScreenSpaceNormals::OrbitViews(const glm::mat4& view) {
+    const float angles[] = { 0, 45, 90, 135, 180, 225, 270, 315 };
+
+    std::vector<glm::mat4> views;
+    glm::mat4 current = view;
+    for (float angle : angles) {
+        current = glm::rotate(current, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+        views.push_back(current);
+    }
+    return views;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "PointCloud.h"
+#include "SoftwareRasterizer.h"
+
+/*
+ * ScreenSpaceNormals
+ *
+ * CPU version of the screen space normal method of Renderer::Render, for
+ * machines without GL 4.5 and for batch jobs:
+ *
+ *  - Accumulate: calc_normal.comp, the cross product of the reconstructed
+ *    left/right and down/up neighbours of every splat pixel, turned to world
+ *    space and summed per point ID
+ *  - Average: average_normal.comp, every point visible in the reference target
+ *    gets its normalized mean normal and the ground truth color class
+ *
+ * The GPU sums in fixed point, which does not depend on the scheduling either.
+ * Here every pixel writes its normal into a per-pixel buffer, the pixels are
+ * stably sorted by ID and each ID is summed in pixel order by exactly one
+ * chunk. The normals are bit identical for any thread count and match the GPU
+ * up to its fixed point rounding.
+ *
+ * ComputeView follows the per-view loop (sums cleared for every view, so the
+ * last view a point is visible in decides), ComputeViews the layered pass
+ * (sums over all views, every point visible in any view is averaged).
+ *
+ * Unlike the shaders, pixels without a usable cross product (equal depths of
+ * opposite neighbours) are skipped and points without a contribution get a
+ * zero normal instead of NaN. Buffers are kept between calls.
+ */
+class ScreenSpaceNormals {
+public:
+    /*
+     * One view of Renderer::Render: reference pass (1 px) and splat pass
+     * (splatSize px) into width x height targets, then Accumulate and Average.
+     * normalsGT holds one ground truth normal per point, like m_pointGTSSBO.
+     */
+    void ComputeView(PointCloud& cloud, const glm::vec4* normalsGT, const glm::mat4& model, const glm::mat4& view,
+        const glm::mat4& projection, float splatSize, int width, int height);
+
+    // all views at once like Renderer::RenderViewsLayered, one Average over the sums of every view
+    void ComputeViews(PointCloud& cloud, const glm::vec4* normalsGT, const glm::mat4& model,
+        const std::vector<glm::mat4>& views, const glm::mat4& projection, float splatSize, int width, int height);
+
+    // zero sums and no visible points
+    void Reset(size_t points);
+
+    // adds the normals of the splat target to the sums of their points
+    void Accumulate(const RasterTarget& splat, const glm::mat4& view, const glm::mat4& projection);
+
+    // marks the points of the reference target for Average
+    void MarkVisible(const RasterTarget& reference);
+
+    // writes normal and color of every marked point
+    void Average(const glm::vec4* normalsGT, PointCloud& cloud) const;
+
+    // views of Renderer::Render: each step turns the previous view further around y, by 0, 45, ..., 315 degrees
+    static std::vector<glm::mat4> OrbitViews(const glm::mat4& view);
+
+    const RasterTarget& Reference() const { return m_reference; }
+    const RasterTarget& Splat() const { return m_splat; }
+
+private:
+    SoftwareRasterizer m_rasterizer;
+    RasterTarget m_reference;
+    RasterTarget m_splat;
+
+    std::vector<glm::vec3> m_pixelNormals;  // world space normal of every splat pixel
+    std::vector<uint32_t> m_pixelKeys;      // point ID of every splat pixel, the point count if it has no normal
+    std::vector<uint32_t> m_order;          // pixels sorted by key
+
+    PointVector<glm::vec3> m_sums;
+    PointVector<int> m_counts;
+    PointVector<uint8_t> m_visible;         // point is in a reference target since the last Reset
+};
@@ -1,4 +1,5 @@
 #include "Shader.h"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -20,6 +21,7 @@ Shader::Shader(const char* vertex_source, const char* fragment_source) {
 
     glDeleteShader(vertex_shader);
     glDeleteShader(fragment_shader);
+    CacheUniforms();
 }
 
 Shader::Shader(const char* vertex_source, const char* geometry_source, const char* fragment_source) {
@@ -43,6 +45,7 @@ Shader::Shader(const char* vertex_source, const char* geometry_source, const cha
 
     glDeleteShader(vertex_shader);
     glDeleteShader(fragment_shader);
+    CacheUniforms();
 }
 
 Shader::Shader(const char* compute_source) {
@@ -76,7 +79,7 @@ Shader::Shader(const char* compute_source) {
     }
 
     glDeleteShader(compute_shader);
-
+    CacheUniforms();
 }
 
 Shader::~Shader() {
@@ -87,6 +90,38 @@ void Shader::Use() {
     glUseProgram(m_shaderID);
 }
 
+GLint Shader::Uniform(const char* name) const {
+    auto it = m_uniforms.find(name);
+    return it != m_uniforms.end() ? it->second : -1;
+}
+
+// all active uniforms, queried once instead of glGetUniformLocation every frame
+void Shader::CacheUniforms() {
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::string name(size_t(std::max(maxLength, 1)), '\0');
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_shaderID, GLuint(i), maxLength, &length, &size, &type, &name[0]);
+        std::string uniform = name.substr(0, size_t(length));
+
+        // block members have no location
+        GLint location = glGetUniformLocation(m_shaderID, uniform.c_str());
+        if (location < 0) continue;
+
+        // arrays are reported as "name[0]", glUniform* callers use both spellings
+        m_uniforms[uniform] = location;
+        if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0) {
+            m_uniforms[uniform.substr(0, uniform.size() - 3)] = location;
+        }
+    }
+}
+
 std::string Shader::ReadFile(const std::string& shader_path) {
     std::ifstream shader_file(shader_path);
     std::stringstream shader_content;
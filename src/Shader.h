@@ -2,6 +2,7 @@
 
 #include <GL/glew.h>
 #include <string>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -19,7 +20,13 @@ public:
 
     void Use();
 
+    // location cached at link time, -1 for names the program does not use (glUniform* ignores -1)
+    GLint Uniform(const char* name) const;
+
 private:
+    std::unordered_map<std::string, GLint> m_uniforms;
+
+    void CacheUniforms();
 
     std::string ReadFile(const std::string& shaderPath);
 
@@ -0,0 +1,134 @@
+#include "SoftwareRasterizer.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace {
+
+    const int TILE_SIZE = 64;
+    const size_t RASTER_MIN_CHUNK = 1 << 15;
+}
+
+void RasterTarget::Resize(int newWidth, int newHeight) {
+    width = newWidth;
+    height = newHeight;
+    depth.resize(size_t(width) * height);
+    ids.resize(size_t(width) * height);
+}
+
+void RasterTarget::Clear() {
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    std::fill(ids.begin(), ids.end(), -1);
+}
+
+void SoftwareRasterizer::DrawPoints(PointCloudView cloud, const glm::mat4& mvp, float pointSize, RasterTarget& target) {
+    const size_t count = cloud.Size();
+    const int width = target.width;
+    const int height = target.height;
+    if (count == 0 || width <= 0 || height <= 0) {
+        return;
+    }
+
+    m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    const size_t tiles = size_t(m_tilesX) * m_tilesY;
+    const float halfSize = 0.5f * std::max(pointSize, 1.0f);
+
+    // projection, covered pixel rectangle and tile counts per chunk
+    const size_t chunks = ChunkCount(count, RASTER_MIN_CHUNK);
+    m_projected.resize(count);
+    m_chunkTileCounts.assign(chunks * tiles, 0);
+    ParallelFor(count, RASTER_MIN_CHUNK, [&](size_t first, size_t last, size_t chunk) {
+        uint32_t* counts = &m_chunkTileCounts[chunk * tiles];
+        for (size_t i = first; i < last; i++) {
+            ProjectedPoint& p = m_projected[i];
+            p.x0 = p.x1 = p.y0 = p.y1 = 0;
+
+            glm::vec4 clip = mvp * glm::vec4(cloud.m_positions[i], 1.0f);
+            if (!(clip.w > 0.0f) || std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w || std::abs(clip.z) > clip.w) {
+                continue;
+            }
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            float xw = (ndc.x * 0.5f + 0.5f) * float(width);
+            float yw = (ndc.y * 0.5f + 0.5f) * float(height);
+            p.depth = ndc.z * 0.5f + 0.5f;
+
+            // pixel centers x + 0.5 in [xw - halfSize, xw + halfSize)
+            p.x0 = std::max(0, int(std::ceil(xw - halfSize - 0.5f)));
+            p.x1 = std::min(width, int(std::ceil(xw + halfSize - 0.5f)));
+            p.y0 = std::max(0, int(std::ceil(yw - halfSize - 0.5f)));
+            p.y1 = std::min(height, int(std::ceil(yw + halfSize - 0.5f)));
+            if (p.x0 >= p.x1 || p.y0 >= p.y1) {
+                p.x1 = p.x0;
+                continue;
+            }
+
+            for (int ty = p.y0 / TILE_SIZE; ty <= (p.y1 - 1) / TILE_SIZE; ty++) {
+                for (int tx = p.x0 / TILE_SIZE; tx <= (p.x1 - 1) / TILE_SIZE; tx++) {
+                    counts[ty * m_tilesX + tx]++;
+                }
+            }
+        }
+    });
+
+    // tile major, chunk minor: inside a bin the points stay in submission order
+    m_binStart.resize(tiles + 1);
+    uint32_t offset = 0;
+    for (size_t t = 0; t < tiles; t++) {
+        m_binStart[t] = offset;
+        for (size_t c = 0; c < chunks; c++) {
+            uint32_t points = m_chunkTileCounts[c * tiles + t];
+            m_chunkTileCounts[c * tiles + t] = offset;
+            offset += points;
+        }
+    }
+    m_binStart[tiles] = offset;
+    m_binned.resize(offset);
+
+    ParallelFor(count, RASTER_MIN_CHUNK, [&](size_t first, size_t last, size_t chunk) {
+        uint32_t* cursors = &m_chunkTileCounts[chunk * tiles];
+        for (size_t i = first; i < last; i++) {
+            const ProjectedPoint& p = m_projected[i];
+            if (p.x0 >= p.x1) continue;
+            for (int ty = p.y0 / TILE_SIZE; ty <= (p.y1 - 1) / TILE_SIZE; ty++) {
+                for (int tx = p.x0 / TILE_SIZE; tx <= (p.x1 - 1) / TILE_SIZE; tx++) {
+                    m_binned[cursors[ty * m_tilesX + tx]++] = static_cast<uint32_t>(i);
+                }
+            }
+        }
+    });
+
+    // tiles are handed out one at a time, the busy ones in the middle of the screen would stall a static split
+    std::atomic<size_t> nextTile(0);
+    ParallelFor(WorkerCount(), 1, [&](size_t, size_t, size_t) {
+        for (size_t t = nextTile++; t < tiles; t = nextTile++) {
+            RasterTile(static_cast<int>(t), target);
+        }
+    });
+}
+
+void SoftwareRasterizer::RasterTile(int tile, RasterTarget& target) const {
+    const int tileX0 = (tile % m_tilesX) * TILE_SIZE;
+    const int tileY0 = (tile / m_tilesX) * TILE_SIZE;
+    const int tileX1 = std::min(tileX0 + TILE_SIZE, target.width);
+    const int tileY1 = std::min(tileY0 + TILE_SIZE, target.height);
+
+    for (uint32_t b = m_binStart[tile]; b < m_binStart[tile + 1]; b++) {
+        uint32_t index = m_binned[b];
+        const ProjectedPoint& p = m_projected[index];
+        const int x0 = std::max(p.x0, tileX0), x1 = std::min(p.x1, tileX1);
+        const int y0 = std::max(p.y0, tileY0), y1 = std::min(p.y1, tileY1);
+
+        for (int y = y0; y < y1; y++) {
+            size_t row = size_t(y) * target.width;
+            for (int x = x0; x < x1; x++) {
+                if (p.depth < target.depth[row + x]) {
+                    target.depth[row + x] = p.depth;
+                    target.ids[row + x] = static_cast<int>(index);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "PointCloud.h"
+
+// CPU counterpart of m_fboRef / m_fboSplat: rows start at the bottom like GL textures
+struct RasterTarget {
+    int width = 0;
+    int height = 0;
+    std::vector<float> depth;   // window depth in [0, 1], cleared to 1
+    std::vector<int> ids;       // point index, cleared to -1
+
+    void Resize(int width, int height);
+    void Clear();
+};
+
+/*
+ * SoftwareRasterizer
+ *
+ * Draws a cloud as GL_POINTS the way depth_pass.vert (1 px) and
+ * biggerSplat_pass.vert (pointSize px) do, with GL_LESS depth testing into a
+ * RasterTarget. The ID written is the point index, as in PackVertices.
+ *
+ *  - projection: clip = mvp * position, points outside the clip volume are
+ *    dropped, window coordinates for a viewport covering the whole target
+ *  - binning: the screen is split into tiles, every chunk of points counts and
+ *    then writes its points into the bins of the tiles they touch; bins keep
+ *    the submission order
+ *  - raster: threads take tiles one by one, a point covers the pixels whose
+ *    centers lie in the pointSize square around it, like non-antialiased GL
+ *    points
+ *
+ * Every pixel sees its points in submission order, so ties resolve like on
+ * the GPU and the result does not depend on the thread count. Depth is kept as
+ * float; the GL target is 32 bit fixed point, so depths read back from it
+ * differ in the last bits. Buffers are kept between calls.
+ */
+class SoftwareRasterizer {
+public:
+    void DrawPoints(PointCloudView cloud, const glm::mat4& mvp, float pointSize, RasterTarget& target);
+
+private:
+    struct ProjectedPoint {
+        int x0, y0, x1, y1;     // covered pixels [x0, x1) x [y0, y1), empty if clipped
+        float depth;
+    };
+
+    void RasterTile(int tile, RasterTarget& target) const;
+
+    int m_tilesX = 0;
+    int m_tilesY = 0;
+    PointVector<ProjectedPoint> m_projected;
+    std::vector<uint32_t> m_chunkTileCounts;    // points per (chunk, tile), then the write cursors
+    std::vector<uint32_t> m_binStart;           // bin of tile t: m_binned[m_binStart[t], m_binStart[t + 1])
+    PointVector<uint32_t> m_binned;             // point indices, grouped by tile
+};
@@ -0,0 +1,146 @@
+#include "SpatialOrder.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+
+    const unsigned RADIX_BITS = 11;
+    const size_t RADIX_SIZE = size_t(1) << RADIX_BITS;
+    const uint32_t RADIX_MASK = static_cast<uint32_t>(RADIX_SIZE - 1);
+    const size_t SORT_MIN_CHUNK = 1 << 16;
+
+    // spreads the lowest 10 bits of value so that two zero bits follow every bit
+    uint32_t SpreadBits(uint32_t value) {
+        value &= 0x000003FF;
+        value = (value | (value << 16)) & 0x030000FF;
+        value = (value | (value << 8)) & 0x0300F00F;
+        value = (value | (value << 4)) & 0x030C30C3;
+        value = (value | (value << 2)) & 0x09249249;
+        return value;
+    }
+
+    // spreads the lowest 21 bits of value so that two zero bits follow every bit
+    uint64_t SpreadBits64(uint64_t value) {
+        value &= 0x1FFFFF;
+        value = (value | (value << 32)) & 0x001F00000000FFFFull;
+        value = (value | (value << 16)) & 0x001F0000FF0000FFull;
+        value = (value | (value << 8)) & 0x100F00F00F00F00Full;
+        value = (value | (value << 4)) & 0x10C30C30C30C30C3ull;
+        value = (value | (value << 2)) & 0x1249249249249249ull;
+        return value;
+    }
+
+    /*
+     * RadixSortOrder
+     *
+     * Every pass sorts by one 11 bit digit: each chunk counts its digits, an
+     * exclusive prefix sum over (digit, chunk) gives every chunk its own output
+     * range per digit, and the chunks scatter keys and indices in parallel.
+     * ParallelFor splits a count the same way every call, so counting and
+     * scattering see identical chunks. Passes in which all keys share a digit
+     * are skipped.
+     */
+    template <typename Key>
+    std::vector<uint32_t> RadixSortOrderImpl(const std::vector<Key>& keys, unsigned keyBits) {
+        const size_t count = keys.size();
+        std::vector<uint32_t> order(count);
+        ParallelFor(count, SORT_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+            for (size_t i = first; i < last; i++) order[i] = static_cast<uint32_t>(i);
+        });
+        if (count < 2) {
+            return order;
+        }
+
+        std::vector<Key> currentKeys(keys);
+        std::vector<Key> nextKeys(count);
+        std::vector<uint32_t> nextOrder(count);
+
+        const size_t chunks = ChunkCount(count, SORT_MIN_CHUNK);
+        std::vector<size_t> offsets(chunks * RADIX_SIZE);
+
+        for (unsigned shift = 0; shift < keyBits; shift += RADIX_BITS) {
+            ParallelFor(count, SORT_MIN_CHUNK, [&](size_t first, size_t last, size_t chunk) {
+                size_t* histogram = &offsets[chunk * RADIX_SIZE];
+                std::fill(histogram, histogram + RADIX_SIZE, size_t(0));
+                for (size_t i = first; i < last; i++) {
+                    histogram[static_cast<uint32_t>(currentKeys[i] >> shift) & RADIX_MASK]++;
+                }
+            });
+
+            bool singleDigit = false;
+            size_t sum = 0;
+            for (size_t digit = 0; digit < RADIX_SIZE; digit++) {
+                size_t digitTotal = 0;
+                for (size_t chunk = 0; chunk < chunks; chunk++) {
+                    size_t& slot = offsets[chunk * RADIX_SIZE + digit];
+                    size_t n = slot;
+                    slot = sum;
+                    sum += n;
+                    digitTotal += n;
+                }
+                if (digitTotal == count) singleDigit = true;
+            }
+            if (singleDigit) {
+                continue;
+            }
+
+            ParallelFor(count, SORT_MIN_CHUNK, [&](size_t first, size_t last, size_t chunk) {
+                size_t* next = &offsets[chunk * RADIX_SIZE];
+                for (size_t i = first; i < last; i++) {
+                    size_t destination = next[static_cast<uint32_t>(currentKeys[i] >> shift) & RADIX_MASK]++;
+                    nextKeys[destination] = currentKeys[i];
+                    nextOrder[destination] = order[i];
+                }
+            });
+
+            currentKeys.swap(nextKeys);
+            order.swap(nextOrder);
+        }
+        return order;
+    }
+}
+
+namespace SpatialOrder {
+
+    std::vector<uint32_t> MortonCodes(PointCloudView cloud) {
+        std::vector<uint32_t> codes(cloud.Size());
+
+        const glm::vec3 extent = cloud.m_boundsMax - cloud.m_boundsMin;
+        const float cells = 1023.0f;
+        glm::vec3 scale;
+        for (int axis = 0; axis < 3; axis++) {
+            scale[axis] = extent[axis] > 0.0f ? cells / extent[axis] : 0.0f;
+        }
+
+        ParallelFor(codes.size(), SORT_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+            for (size_t i = first; i < last; i++) {
+                glm::vec3 cell = glm::clamp((cloud.m_positions[i] - cloud.m_boundsMin) * scale, 0.0f, cells);
+                codes[i] = SpreadBits(static_cast<uint32_t>(cell.x))
+                    | (SpreadBits(static_cast<uint32_t>(cell.y)) << 1)
+                    | (SpreadBits(static_cast<uint32_t>(cell.z)) << 2);
+            }
+        });
+        return codes;
+    }
+
+    uint64_t MortonKey(uint32_t x, uint32_t y, uint32_t z) {
+        return SpreadBits64(x) | (SpreadBits64(y) << 1) | (SpreadBits64(z) << 2);
+    }
+
+    std::vector<uint32_t> RadixSortOrder(const std::vector<uint32_t>& keys, unsigned keyBits) {
+        return RadixSortOrderImpl(keys, keyBits);
+    }
+
+    std::vector<uint32_t> RadixSortOrder(const std::vector<uint64_t>& keys, unsigned keyBits) {
+        return RadixSortOrderImpl(keys, keyBits);
+    }
+
+    std::vector<uint32_t> SortMorton(PointCloud& cloud) {
+        cloud.ComputeBounds();
+        std::vector<uint32_t> order = RadixSortOrder(MortonCodes(cloud), 30);
+        cloud.Reorder(order);
+        return order;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "PointCloud.h"
+
+/*
+ * SpatialOrder
+ *
+ * Load time reordering of a cloud along a 3D Morton (Z-order) curve inside its
+ * bounds, so points that are close in space are also close in memory. The
+ * depth and splat passes then emit IDs of neighbouring points together and the
+ * SSBO accesses in calc_normal.comp / average_normal.comp stay local.
+ *
+ * Point IDs move with their points, so m_ids still holds the original IDs. The
+ * GPU buffers are indexed by position in the sorted cloud; ground truth lookups
+ * and exports go through the original IDs.
+ */
+namespace SpatialOrder {
+
+	// 30 bit Morton code per point (10 bits per axis), quantized to m_boundsMin/m_boundsMax
+	std::vector<uint32_t> MortonCodes(PointCloudView cloud);
+
+	// 63 bit Morton key of integer cell coordinates (21 bits per axis)
+	uint64_t MortonKey(uint32_t x, uint32_t y, uint32_t z);
+
+	// permutation that sorts keys ascending (stable), parallel LSD radix sort over the lowest keyBits bits
+	std::vector<uint32_t> RadixSortOrder(const std::vector<uint32_t>& keys, unsigned keyBits = 32);
+	std::vector<uint32_t> RadixSortOrder(const std::vector<uint64_t>& keys, unsigned keyBits = 64);
+
+	// reorders all channels of cloud along the Morton curve, returns the applied order (see PointCloud::Reorder)
+	std::vector<uint32_t> SortMorton(PointCloud& cloud);
+}
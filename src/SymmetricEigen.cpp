@@ -0,0 +1,333 @@
+#include "SymmetricEigen.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define SYMMETRIC_EIGEN_AVX512 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define SYMMETRIC_EIGEN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SYMMETRIC_EIGEN_SSE2 1
+#endif
+
+namespace {
+
+    const int JACOBI_SWEEPS = 5;
+    const float TINY = 1e-30f;
+
+    /*
+     * Lanes
+     *
+     * The few operations the kernel needs on one register of floats. Mask is
+     * the result of a comparison, Select(mask, a, b) takes a where mask is set.
+     * FlipSign(value, sign) negates value where the sign bit of sign is set.
+     */
+#if defined(SYMMETRIC_EIGEN_AVX512)
+    struct Lanes {
+        using Vec = __m512;
+        using Mask = __mmask16;
+        static const size_t WIDTH = 16;
+        static const char* Name() { return "AVX-512"; }
+
+        static Vec Load(const float* p) { return _mm512_loadu_ps(p); }
+        static void Store(float* p, Vec v) { _mm512_storeu_ps(p, v); }
+        static Vec Set(float f) { return _mm512_set1_ps(f); }
+        static Vec Add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+        static Vec Sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+        static Vec Mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+        static Vec Div(Vec a, Vec b) { return _mm512_div_ps(a, b); }
+        static Vec Sqrt(Vec a) { return _mm512_sqrt_ps(a); }
+        static Vec Max(Vec a, Vec b) { return _mm512_max_ps(a, b); }
+        static Vec Abs(Vec a) { return _mm512_abs_ps(a); }
+        static Vec FlipSign(Vec value, Vec sign) {
+            const __m512i signBit = _mm512_set1_epi32(int(0x80000000u));
+            return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(value),
+                _mm512_and_si512(_mm512_castps_si512(sign), signBit)));
+        }
+        static Mask Less(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static Vec Select(Mask m, Vec a, Vec b) { return _mm512_mask_blend_ps(m, b, a); }
+    };
+#elif defined(SYMMETRIC_EIGEN_AVX2)
+    struct Lanes {
+        using Vec = __m256;
+        using Mask = __m256;
+        static const size_t WIDTH = 8;
+        static const char* Name() { return "AVX2"; }
+
+        static Vec Load(const float* p) { return _mm256_loadu_ps(p); }
+        static void Store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+        static Vec Set(float f) { return _mm256_set1_ps(f); }
+        static Vec Add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+        static Vec Sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+        static Vec Mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+        static Vec Div(Vec a, Vec b) { return _mm256_div_ps(a, b); }
+        static Vec Sqrt(Vec a) { return _mm256_sqrt_ps(a); }
+        static Vec Max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+        static Vec Abs(Vec a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static Vec FlipSign(Vec value, Vec sign) {
+            return _mm256_xor_ps(value, _mm256_and_ps(sign, _mm256_set1_ps(-0.0f)));
+        }
+        static Mask Less(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static Vec Select(Mask m, Vec a, Vec b) { return _mm256_blendv_ps(b, a, m); }
+    };
+#elif defined(SYMMETRIC_EIGEN_SSE2)
+    struct Lanes {
+        using Vec = __m128;
+        using Mask = __m128;
+        static const size_t WIDTH = 4;
+        static const char* Name() { return "SSE2"; }
+
+        static Vec Load(const float* p) { return _mm_loadu_ps(p); }
+        static void Store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+        static Vec Set(float f) { return _mm_set1_ps(f); }
+        static Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+        static Vec Sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+        static Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+        static Vec Div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+        static Vec Sqrt(Vec a) { return _mm_sqrt_ps(a); }
+        static Vec Max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+        static Vec Abs(Vec a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        static Vec FlipSign(Vec value, Vec sign) {
+            return _mm_xor_ps(value, _mm_and_ps(sign, _mm_set1_ps(-0.0f)));
+        }
+        static Mask Less(Vec a, Vec b) { return _mm_cmplt_ps(a, b); }
+        static Vec Select(Mask m, Vec a, Vec b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    };
+#else
+    struct Lanes {
+        using Vec = float;
+        using Mask = bool;
+        static const size_t WIDTH = 1;
+        static const char* Name() { return "scalar"; }
+
+        static Vec Load(const float* p) { return *p; }
+        static void Store(float* p, Vec v) { *p = v; }
+        static Vec Set(float f) { return f; }
+        static Vec Add(Vec a, Vec b) { return a + b; }
+        static Vec Sub(Vec a, Vec b) { return a - b; }
+        static Vec Mul(Vec a, Vec b) { return a * b; }
+        static Vec Div(Vec a, Vec b) { return a / b; }
+        static Vec Sqrt(Vec a) { return std::sqrt(a); }
+        static Vec Max(Vec a, Vec b) { return a > b ? a : b; }
+        static Vec Abs(Vec a) { return std::fabs(a); }
+        static Vec FlipSign(Vec value, Vec sign) { return std::signbit(sign) ? -value : value; }
+        static Mask Less(Vec a, Vec b) { return a < b; }
+        static Vec Select(Mask m, Vec a, Vec b) { return m ? a : b; }
+    };
+#endif
+
+    using Vec = Lanes::Vec;
+
+#if defined(SYMMETRIC_EIGEN_AVX512) || defined(SYMMETRIC_EIGEN_AVX2) || defined(SYMMETRIC_EIGEN_SSE2)
+    /*
+     * Flushes denormals to zero (MXCSR FTZ and DAZ) for the lifetime of the
+     * object. Converged off-diagonal entries underflow into denormals during
+     * the last sweeps, which are many times slower on most x86 cores and do
+     * not change the result.
+     */
+    class FlushDenormals {
+    public:
+        FlushDenormals() : m_saved(_mm_getcsr()) { _mm_setcsr(m_saved | FLUSH_TO_ZERO | DENORMALS_ARE_ZERO); }
+        ~FlushDenormals() { _mm_setcsr(m_saved); }
+
+    private:
+        static const unsigned int FLUSH_TO_ZERO = 0x8000;
+        static const unsigned int DENORMALS_ARE_ZERO = 0x0040;
+        unsigned int m_saved;
+    };
+#else
+    class FlushDenormals {};
+#endif
+
+    // registers solved together, see SolveBatch
+    const size_t INTERLEAVE = 4;
+    const size_t BATCH = Lanes::WIDTH * INTERLEAVE;
+
+    /*
+     * Rotate
+     *
+     * One Jacobi rotation that zeroes a(p, q); r is the third index. The
+     * tangent t = 2 a_pq sign(d) / (|d| + sqrt(d^2 + 4 a_pq^2)), d = a_qq - a_pp,
+     * is the smaller root and stays finite for a_pq = 0. Columns p and q of the
+     * eigenvector matrix v are rotated along.
+     */
+    inline void Rotate(Vec& app, Vec& aqq, Vec& apq, Vec& arp, Vec& arq, Vec vp[3], Vec vq[3]) {
+        Vec d = Lanes::Sub(aqq, app);
+        Vec twoApq = Lanes::Add(apq, apq);
+        Vec root = Lanes::Sqrt(Lanes::Add(Lanes::Mul(d, d), Lanes::Mul(twoApq, twoApq)));
+        // d = +-0 takes its sign from the zero, both are valid rotations
+        Vec t = Lanes::Div(Lanes::FlipSign(twoApq, d), Lanes::Add(Lanes::Add(Lanes::Abs(d), root), Lanes::Set(TINY)));
+        Vec c = Lanes::Div(Lanes::Set(1.0f), Lanes::Sqrt(Lanes::Add(Lanes::Mul(t, t), Lanes::Set(1.0f))));
+        Vec s = Lanes::Mul(t, c);
+
+        Vec tApq = Lanes::Mul(t, apq);
+        app = Lanes::Sub(app, tApq);
+        aqq = Lanes::Add(aqq, tApq);
+        apq = Lanes::Set(0.0f);
+
+        Vec g = arp, h = arq;
+        arp = Lanes::Sub(Lanes::Mul(c, g), Lanes::Mul(s, h));
+        arq = Lanes::Add(Lanes::Mul(s, g), Lanes::Mul(c, h));
+
+        for (int k = 0; k < 3; k++) {
+            Vec p = vp[k], q = vq[k];
+            vp[k] = Lanes::Sub(Lanes::Mul(c, p), Lanes::Mul(s, q));
+            vq[k] = Lanes::Add(Lanes::Mul(s, p), Lanes::Mul(c, q));
+        }
+    }
+
+    // orders (value, column) pairs a and b so that a holds the smaller value
+    inline void SortPair(Vec& valueA, Vec& valueB, Vec vectorA[3], Vec vectorB[3]) {
+        Lanes::Mask swap = Lanes::Less(valueB, valueA);
+        Vec low = Lanes::Select(swap, valueB, valueA);
+        valueB = Lanes::Select(swap, valueA, valueB);
+        valueA = low;
+        for (int k = 0; k < 3; k++) {
+            Vec a = Lanes::Select(swap, vectorB[k], vectorA[k]);
+            vectorB[k] = Lanes::Select(swap, vectorA[k], vectorB[k]);
+            vectorA[k] = a;
+        }
+    }
+
+    // state of one register of matrices
+    struct Jacobi {
+        Vec a00, a01, a02, a11, a12, a22;
+        Vec v0[3], v1[3], v2[3];    // columns of the eigenvector matrix
+        Vec scale;
+    };
+
+    /*
+     * SolveBatch
+     *
+     * in: xx xy xz yy yz zz, out: value0 value1 value2 x y z, BATCH floats each.
+     * Every rotation is a chain of square roots and divisions, so one register
+     * alone would wait on their latency. The INTERLEAVE registers of a batch go
+     * through every step together, their chains are independent and overlap.
+     */
+    void SolveBatch(const float* const in[6], float* const out[6]) {
+        Jacobi j[INTERLEAVE];
+        const Vec zero = Lanes::Set(0.0f), one = Lanes::Set(1.0f);
+
+        for (size_t g = 0; g < INTERLEAVE; g++) {
+            size_t offset = g * Lanes::WIDTH;
+            Jacobi& m = j[g];
+            m.a00 = Lanes::Load(in[0] + offset); m.a01 = Lanes::Load(in[1] + offset); m.a02 = Lanes::Load(in[2] + offset);
+            m.a11 = Lanes::Load(in[3] + offset); m.a12 = Lanes::Load(in[4] + offset); m.a22 = Lanes::Load(in[5] + offset);
+
+            // scale to a largest entry of 1, keeps the squares in Rotate away from under- and overflow
+            Vec scale = Lanes::Max(Lanes::Max(Lanes::Max(Lanes::Abs(m.a00), Lanes::Abs(m.a11)), Lanes::Max(Lanes::Abs(m.a22), Lanes::Abs(m.a01))),
+                Lanes::Max(Lanes::Abs(m.a02), Lanes::Abs(m.a12)));
+            m.scale = Lanes::Max(scale, Lanes::Set(TINY));
+            Vec inverse = Lanes::Div(one, m.scale);
+            m.a00 = Lanes::Mul(m.a00, inverse); m.a01 = Lanes::Mul(m.a01, inverse); m.a02 = Lanes::Mul(m.a02, inverse);
+            m.a11 = Lanes::Mul(m.a11, inverse); m.a12 = Lanes::Mul(m.a12, inverse); m.a22 = Lanes::Mul(m.a22, inverse);
+
+            m.v0[0] = one;  m.v0[1] = zero; m.v0[2] = zero;
+            m.v1[0] = zero; m.v1[1] = one;  m.v1[2] = zero;
+            m.v2[0] = zero; m.v2[1] = zero; m.v2[2] = one;
+        }
+
+        for (int sweep = 0; sweep < JACOBI_SWEEPS; sweep++) {
+            for (Jacobi& m : j) Rotate(m.a00, m.a11, m.a01, m.a02, m.a12, m.v0, m.v1);
+            for (Jacobi& m : j) Rotate(m.a00, m.a22, m.a02, m.a01, m.a12, m.v0, m.v2);
+            for (Jacobi& m : j) Rotate(m.a11, m.a22, m.a12, m.a01, m.a02, m.v1, m.v2);
+        }
+
+        for (size_t g = 0; g < INTERLEAVE; g++) {
+            size_t offset = g * Lanes::WIDTH;
+            Jacobi& m = j[g];
+
+            // three compare and swaps sort the eigenvalues ascending
+            SortPair(m.a00, m.a11, m.v0, m.v1);
+            SortPair(m.a11, m.a22, m.v1, m.v2);
+            SortPair(m.a00, m.a11, m.v0, m.v1);
+
+            Lanes::Store(out[0] + offset, Lanes::Mul(m.a00, m.scale));
+            Lanes::Store(out[1] + offset, Lanes::Mul(m.a11, m.scale));
+            Lanes::Store(out[2] + offset, Lanes::Mul(m.a22, m.scale));
+            Lanes::Store(out[3] + offset, m.v0[0]);
+            Lanes::Store(out[4] + offset, m.v0[1]);
+            Lanes::Store(out[5] + offset, m.v0[2]);
+        }
+    }
+}
+
+namespace SymmetricEigen {
+
+    void SymmetricMatrices::Resize(size_t count) {
+        for (std::vector<float>* entry : { &xx, &xy, &xz, &yy, &yz, &zz }) entry->resize(count);
+    }
+
+    void SmallestEigen::Resize(size_t count) {
+        for (std::vector<float>* entry : { &value0, &value1, &value2, &x, &y, &z }) entry->resize(count);
+    }
+
+    size_t BatchWidth() {
+        return BATCH;
+    }
+
+    const char* InstructionSet() {
+        return Lanes::Name();
+    }
+
+    void Solve(const SymmetricMatrices& matrices, SmallestEigen& result) {
+        const size_t count = matrices.Size();
+        result.Resize(count);
+        FlushDenormals flush;
+
+        size_t i = 0;
+        for (; i + BATCH <= count; i += BATCH) {
+            const float* const in[6] = { &matrices.xx[i], &matrices.xy[i], &matrices.xz[i],
+                &matrices.yy[i], &matrices.yz[i], &matrices.zz[i] };
+            float* const out[6] = { &result.value0[i], &result.value1[i], &result.value2[i],
+                &result.x[i], &result.y[i], &result.z[i] };
+            SolveBatch(in, out);
+        }
+
+        // the tail goes through one zero padded batch
+        if (i < count) {
+            size_t rest = count - i;
+            float input[6][BATCH] = {};
+            float output[6][BATCH];
+            const std::vector<float>* sources[6] = { &matrices.xx, &matrices.xy, &matrices.xz, &matrices.yy, &matrices.yz, &matrices.zz };
+            std::vector<float>* targets[6] = { &result.value0, &result.value1, &result.value2, &result.x, &result.y, &result.z };
+            for (int entry = 0; entry < 6; entry++) {
+                std::memcpy(input[entry], sources[entry]->data() + i, rest * sizeof(float));
+            }
+            const float* const in[6] = { input[0], input[1], input[2], input[3], input[4], input[5] };
+            float* const out[6] = { output[0], output[1], output[2], output[3], output[4], output[5] };
+            SolveBatch(in, out);
+            for (int entry = 0; entry < 6; entry++) {
+                std::memcpy(targets[entry]->data() + i, output[entry], rest * sizeof(float));
+            }
+        }
+    }
+
+    void NeighbourhoodCovariance(const glm::vec3* positions, uint32_t center, const uint32_t* neighbours, size_t count,
+        SymmetricMatrices& matrices, size_t slot) {
+        const glm::vec3 origin = positions[center];
+
+        // the center adds a zero offset
+        glm::dvec3 sum(0.0);
+        double xx = 0.0, xy = 0.0, xz = 0.0, yy = 0.0, yz = 0.0, zz = 0.0;
+        for (size_t n = 0; n < count; n++) {
+            glm::dvec3 d(positions[neighbours[n]] - origin);
+            sum += d;
+            xx += d.x * d.x; xy += d.x * d.y; xz += d.x * d.z;
+            yy += d.y * d.y; yz += d.y * d.z; zz += d.z * d.z;
+        }
+
+        double points = double(count + 1);
+        glm::dvec3 mean = sum / points;
+        matrices.xx[slot] = static_cast<float>(xx / points - mean.x * mean.x);
+        matrices.xy[slot] = static_cast<float>(xy / points - mean.x * mean.y);
+        matrices.xz[slot] = static_cast<float>(xz / points - mean.x * mean.z);
+        matrices.yy[slot] = static_cast<float>(yy / points - mean.y * mean.y);
+        matrices.yz[slot] = static_cast<float>(yz / points - mean.y * mean.z);
+        matrices.zz[slot] = static_cast<float>(zz / points - mean.z * mean.z);
+    }
+}
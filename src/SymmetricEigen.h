@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PointCloud.h"
+
+/*
+ * SymmetricEigen
+ *
+ * Eigen decomposition of many symmetric 3x3 matrices at once, for covariance
+ * based normals and curvature. Matrices and results are stored as structure
+ * of arrays, so one SIMD register holds the same entry of 16, 8 or 4
+ * matrices. The instruction set is chosen at compile time: AVX-512 or AVX2
+ * when the build enables them, SSE2 on every x64 build, scalar otherwise. BatchWidth() matrices are solved per step,
+ * a multiple of the register width.
+ */
+namespace SymmetricEigen {
+
+    // upper triangle of count symmetric matrices
+    struct SymmetricMatrices {
+        std::vector<float> xx, xy, xz, yy, yz, zz;
+
+        void Resize(size_t count);
+        size_t Size() const { return xx.size(); }
+    };
+
+    // eigenvalues in ascending order and the unit eigenvector of the smallest one
+    struct SmallestEigen {
+        std::vector<float> value0, value1, value2;
+        std::vector<float> x, y, z;
+
+        void Resize(size_t count);
+        size_t Size() const { return value0.size(); }
+    };
+
+    size_t BatchWidth();
+    const char* InstructionSet();
+
+    /*
+     * Solves all matrices, result is resized to match. Every matrix is scaled by
+     * its largest entry first, then runs a fixed number of cyclic Jacobi sweeps
+     * without branches, so all lanes of a batch take the same path. A zero
+     * matrix gets zero eigenvalues and the x axis as eigenvector.
+     */
+    void Solve(const SymmetricMatrices& matrices, SmallestEigen& result);
+
+    /*
+     * Covariance of the point positions[center] and its neighbours, written to
+     * slot of matrices. Offsets are taken relative to the center point, which
+     * keeps positions far away from the origin precise.
+     */
+    void NeighbourhoodCovariance(const glm::vec3* positions, uint32_t center, const uint32_t* neighbours, size_t count,
+        SymmetricMatrices& matrices, size_t slot);
+}
@@ -0,0 +1,197 @@
+#include "ViewPlanner.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+    const size_t PLAN_MIN_CHUNK = 1 << 15;
+    const float FIT_MARGIN = 1.05f;         // bounding sphere radius scale for the camera distance and depth range
+    const float MIN_NEAR_RATIO = 0.001f;    // near plane at least this share of the camera distance
+}
+
+ViewPlan ViewPlanner::Plan(PointCloudView cloud, const ViewPlanOptions& options) {
+    auto begin = std::chrono::steady_clock::now();
+    ViewPlan plan;
+    const size_t count = cloud.Size();
+    if (count == 0 || options.width <= 0 || options.height <= 0 || options.candidates <= 0) {
+        return plan;
+    }
+
+    // bounding sphere around the center of the bounds
+    const size_t chunks = ChunkCount(count, PLAN_MIN_CHUNK);
+    std::vector<glm::vec3> chunkMin(chunks), chunkMax(chunks);
+    ParallelFor(count, PLAN_MIN_CHUNK, [&](size_t first, size_t last, size_t chunk) {
+        glm::vec3 low = cloud.m_positions[first], high = cloud.m_positions[first];
+        for (size_t i = first; i < last; i++) {
+            low = glm::min(low, cloud.m_positions[i]);
+            high = glm::max(high, cloud.m_positions[i]);
+        }
+        chunkMin[chunk] = low;
+        chunkMax[chunk] = high;
+    });
+    glm::vec3 boundsMin = chunkMin[0], boundsMax = chunkMax[0];
+    for (size_t c = 1; c < chunks; c++) {
+        boundsMin = glm::min(boundsMin, chunkMin[c]);
+        boundsMax = glm::max(boundsMax, chunkMax[c]);
+    }
+    const glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+
+    std::vector<float> chunkRadius(chunks, 0.0f);
+    ParallelFor(count, PLAN_MIN_CHUNK, [&](size_t first, size_t last, size_t chunk) {
+        float radius2 = 0.0f;
+        for (size_t i = first; i < last; i++) {
+            glm::vec3 d = cloud.m_positions[i] - center;
+            radius2 = std::max(radius2, glm::dot(d, d));
+        }
+        chunkRadius[chunk] = radius2;
+    });
+    float radius = std::sqrt(*std::max_element(chunkRadius.begin(), chunkRadius.end()));
+    radius = std::max(radius, 1e-6f) * FIT_MARGIN;
+
+    // the sphere fits into the narrower of the two fields of view
+    const float aspect = float(options.width) / float(options.height);
+    const float halfFov = 0.5f * std::min(options.fovY, 2.0f * std::atan(std::tan(0.5f * options.fovY) * aspect));
+    plan.distance = radius / std::sin(halfFov);
+    plan.zNear = std::max(plan.distance - radius, plan.distance * MIN_NEAR_RATIO);
+    plan.zFar = plan.distance + radius;
+    plan.projection = glm::perspective(options.fovY, aspect, plan.zNear, plan.zFar);
+
+    // a thinned cloud on a smaller target keeps the points per pixel, so splats of the same pixel size overlap like in
+    // the full passes
+    const float scale = std::min(1.0f, float(std::max(options.sampleWidth, 1)) / float(options.width));
+    const int sampleWidth = std::max(1, int(std::lround(options.width * scale)));
+    const int sampleHeight = std::max(1, int(std::lround(options.height * scale)));
+    const size_t stride = std::max<size_t>(1, size_t(std::lround(1.0f / (scale * scale))));
+    const size_t samples = (count + stride - 1) / stride;
+    m_sample.Resize(samples);
+    ParallelFor(samples, PLAN_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+        for (size_t i = first; i < last; i++) {
+            m_sample.m_positions[i] = cloud.m_positions[i * stride];
+        }
+    });
+
+    // every candidate is rasterized once, the greedy steps only walk the point lists
+    const std::vector<glm::vec3> directions = FibonacciSphere(options.candidates);
+    const size_t candidates = directions.size();
+    std::vector<glm::mat4> candidateViews(candidates);
+    m_reference.Resize(sampleWidth, sampleHeight);
+    m_splat.Resize(sampleWidth, sampleHeight);
+    m_pixels.assign(samples, 0);
+    m_visible.assign(samples, 0);
+    m_candidatePoints.resize(candidates);
+    for (size_t c = 0; c < candidates; c++) {
+        const glm::vec3& direction = directions[c];
+        glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        candidateViews[c] = glm::lookAt(center + direction * plan.distance, center, up);
+        RasterCandidate(plan.projection * candidateViews[c], options.splatSize, m_candidatePoints[c]);
+    }
+
+    std::vector<uint32_t> counters(samples, 0);
+    std::vector<uint8_t> visible(samples, 0);
+    std::vector<uint8_t> covered(samples, 0);
+    std::vector<uint8_t> chosen(candidates, 0);
+    std::vector<size_t> gains(candidates, 0);
+    const uint32_t minCount = uint32_t(std::max(options.minCount, 1));
+    size_t coveredCount = 0;
+
+    while (int(plan.views.size()) < options.maxViews) {
+        ParallelFor(candidates, 1, [&](size_t first, size_t last, size_t) {
+            for (size_t c = first; c < last; c++) {
+                size_t gain = 0;
+                if (!chosen[c]) {
+                    for (const CandidatePoint& p : m_candidatePoints[c]) {
+                        gain += !covered[p.point] && (visible[p.point] || p.visible) && counters[p.point] + p.pixels >= minCount;
+                    }
+                }
+                gains[c] = gain;
+            }
+        });
+
+        // the first candidate wins ties, so the plan does not depend on the thread count
+        size_t best = std::max_element(gains.begin(), gains.end()) - gains.begin();
+        size_t gain = gains[best];
+        if (gain == 0 || (!plan.views.empty() && double(gain) < double(options.minGain) * double(samples))) {
+            break;
+        }
+
+        for (const CandidatePoint& p : m_candidatePoints[best]) {
+            counters[p.point] += p.pixels;
+            visible[p.point] |= uint8_t(p.visible);
+            if (!covered[p.point] && visible[p.point] && counters[p.point] >= minCount) {
+                covered[p.point] = 1;
+                coveredCount++;
+            }
+        }
+        chosen[best] = 1;
+        plan.views.push_back(candidateViews[best]);
+        plan.coverage.push_back(float(double(coveredCount) / double(samples)));
+
+        const glm::vec3& direction = directions[best];
+        std::cout << "  view " << plan.views.size() - 1 << ": direction (" << direction.x << ", " << direction.y << ", "
+            << direction.z << "), +" << gain << " points, coverage " << 100.0f * plan.coverage.back() << " %\n";
+
+        if (plan.coverage.back() >= options.targetCoverage) {
+            break;
+        }
+    }
+
+    std::cout << "View planner: " << plan.views.size() << " of " << candidates << " views, coverage "
+        << (plan.coverage.empty() ? 0.0f : 100.0f * plan.coverage.back()) << " % of " << samples
+        << " sampled points (distance " << plan.distance << ", near " << plan.zNear << ", far " << plan.zFar << ") in "
+        << MillisecondsSince(begin) << " ms" << std::endl;
+    return plan;
+}
+
+void ViewPlanner::RasterCandidate(const glm::mat4& mvp, float splatSize, std::vector<CandidatePoint>& points) {
+    m_reference.Clear();
+    m_splat.Clear();
+    m_rasterizer.DrawPoints(m_sample, mvp, 1.0f, m_reference);
+    m_rasterizer.DrawPoints(m_sample, mvp, splatSize, m_splat);
+
+    const int width = m_splat.width;
+    const int height = m_splat.height;
+    points.clear();
+
+    // border pixels get no normal in calc_normal.comp
+    for (int y = 1; y < height - 1; y++) {
+        for (int x = 1; x < width - 1; x++) {
+            int id = m_splat.ids[size_t(y) * width + x];
+            if (id < 0) continue;
+            if (m_pixels[id] == 0) points.push_back({ uint32_t(id), 0, 0 });
+            if (m_pixels[id] < UINT16_MAX) m_pixels[id]++;
+        }
+    }
+    for (int id : m_reference.ids) {
+        if (id < 0 || m_visible[id]) continue;
+        m_visible[id] = 1;
+        if (m_pixels[id] == 0) points.push_back({ uint32_t(id), 0, 0 });
+    }
+
+    // scratch back to zero for the next candidate
+    for (CandidatePoint& p : points) {
+        p.pixels = m_pixels[p.point];
+        p.visible = m_visible[p.point];
+        m_pixels[p.point] = 0;
+        m_visible[p.point] = 0;
+    }
+}
+
+std::vector<glm::vec3> ViewPlanner::FibonacciSphere(int count) {
+    const float goldenAngle = 3.14159265f * (3.0f - std::sqrt(5.0f));
+
+    std::vector<glm::vec3> directions;
+    directions.reserve(size_t(std::max(count, 0)));
+    for (int i = 0; i < count; i++) {
+        float y = 1.0f - 2.0f * (float(i) + 0.5f) / float(count);
+        float r = std::sqrt(std::max(0.0f, 1.0f - y * y));
+        float phi = goldenAngle * float(i);
+        directions.push_back(glm::vec3(r * std::cos(phi), y, r * std::sin(phi)));
+    }
+    return directions;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "PointCloud.h"
+#include "SoftwareRasterizer.h"
+
+struct ViewPlanOptions {
+    int width = 1920;               // target size of the normal passes
+    int height = 1080;
+    float fovY = 0.7854f;           // vertical field of view in radians
+    float splatSize = 3.0f;         // point size of the splat pass
+    int maxViews = 8;               // view budget; the layered path takes at most MAX_VIEW_LAYERS
+    float targetCoverage = 0.99f;   // stop once this share of the points is covered
+    float minGain = 0.001f;         // stop once the best view covers less than this share of new points
+    int minCount = 1;               // splat pixels (the counter of calc_normal.comp) a point needs to be covered
+    int candidates = 48;            // view directions, evenly spread over a sphere
+    int sampleWidth = 480;          // width of the planning targets, the cloud is thinned to the same points per pixel
+};
+
+struct ViewPlan {
+    std::vector<glm::mat4> views;   // object space: the view * model of the passes
+    std::vector<float> coverage;    // share of the points covered after each view
+    glm::mat4 projection = glm::mat4(1.0f);
+    float zNear = 0.1f;
+    float zFar = 100.0f;
+    float distance = 0.0f;          // camera to bounding sphere center
+};
+
+/*
+ * ViewPlanner
+ *
+ * Picks the views of the normal passes for a cloud instead of the fixed orbit
+ * of ScreenSpaceNormals::OrbitViews:
+ *
+ *  - fit: every view looks at the center of the bounding sphere from a
+ *    distance that keeps the whole sphere in the frustum, near and far enclose
+ *    the sphere
+ *  - candidates: directions on a Fibonacci sphere, so the top and bottom are
+ *    covered as well as the sides
+ *  - coverage: a point is covered once it is in the reference target of a
+ *    chosen view and the splat targets of the chosen views gave it minCount
+ *    pixels, like a point average_normal.comp averages with a counter of at
+ *    least minCount
+ *  - greedy: the next view is the candidate that covers the most points not
+ *    covered yet, until targetCoverage, maxViews or minGain is reached
+ *
+ * Every candidate is rasterized once with SoftwareRasterizer on a
+ * sampleWidth target with a thinned copy of the cloud, so the planning cost
+ * does not grow with the target size. Coverage is reported per view.
+ */
+class ViewPlanner {
+public:
+    ViewPlan Plan(PointCloudView cloud, const ViewPlanOptions& options);
+
+    static std::vector<glm::vec3> FibonacciSphere(int count);
+
+private:
+    struct CandidatePoint {
+        uint32_t point;     // index into m_sample
+        uint16_t pixels;    // splat pixels of the point
+        uint16_t visible;   // point is in the reference target
+    };
+
+    void RasterCandidate(const glm::mat4& mvp, float splatSize, std::vector<CandidatePoint>& points);
+
+    SoftwareRasterizer m_rasterizer;
+    RasterTarget m_reference;
+    RasterTarget m_splat;
+    PointCloud m_sample;
+
+    std::vector<uint16_t> m_pixels;     // scratch: splat pixels per sample point of one candidate
+    std::vector<uint8_t> m_visible;     // scratch: sample point is in the reference target of one candidate
+    std::vector<std::vector<CandidatePoint>> m_candidatePoints;
+};
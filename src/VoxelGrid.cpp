@@ -0,0 +1,140 @@
+#include "VoxelGrid.h"
+#include "Parallel.h"
+#include "SpatialOrder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+    const size_t VOXEL_MIN_CHUNK = 1 << 16;
+    const uint32_t MAX_VOXEL_COORD = (1u << 21) - 1;
+}
+
+namespace VoxelGrid {
+
+    /*
+     * Downsample
+     *
+     *  - voxel key per point: Morton code of its integer voxel coordinates (parallel)
+     *  - radix sort of the keys, only over the bits the grid actually uses
+     *  - voxel starts: every chunk counts the key changes in its range, a prefix
+     *    sum over the chunks gives each chunk its first voxel index
+     *  - one representative per voxel, reduced in parallel over the voxels
+     *
+     * Representatives come out in voxel Morton order.
+     */
+    VoxelDownsample Downsample(PointCloudView cloud, float voxelSize) {
+        VoxelDownsample result;
+        const size_t count = cloud.Size();
+        if (count == 0 || !(voxelSize > 0.0f)) {
+            std::cerr << "Voxel downsampling needs points and a positive voxel size." << std::endl;
+            return result;
+        }
+
+        glm::vec3 extent = (cloud.m_boundsMax - cloud.m_boundsMin) / voxelSize;
+        uint32_t maxCoord = static_cast<uint32_t>(std::min(std::max({ extent.x, extent.y, extent.z }), float(MAX_VOXEL_COORD)));
+        unsigned bitsPerAxis = 1;
+        while (bitsPerAxis < 21 && (maxCoord >> bitsPerAxis) != 0) bitsPerAxis++;
+        if (std::max({ extent.x, extent.y, extent.z }) > float(MAX_VOXEL_COORD)) {
+            std::cerr << "Voxel size too small for the cloud bounds, outer voxels are merged." << std::endl;
+        }
+
+        std::vector<uint64_t> keys(count);
+        const float inverseSize = 1.0f / voxelSize;
+        ParallelFor(count, VOXEL_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+            for (size_t i = first; i < last; i++) {
+                glm::vec3 cell = glm::clamp((cloud.m_positions[i] - cloud.m_boundsMin) * inverseSize, 0.0f, float(MAX_VOXEL_COORD));
+                keys[i] = SpatialOrder::MortonKey(static_cast<uint32_t>(cell.x), static_cast<uint32_t>(cell.y), static_cast<uint32_t>(cell.z));
+            }
+        });
+
+        std::vector<uint32_t> order = SpatialOrder::RadixSortOrder(keys, 3 * bitsPerAxis);
+        auto isVoxelStart = [&](size_t k) {
+            return k == 0 || keys[order[k]] != keys[order[k - 1]];
+        };
+
+        // voxel start positions (in sorted order)
+        const size_t chunks = ChunkCount(count, VOXEL_MIN_CHUNK);
+        std::vector<size_t> chunkVoxels(chunks + 1, 0);
+        ParallelFor(count, VOXEL_MIN_CHUNK, [&](size_t first, size_t last, size_t chunk) {
+            size_t starts = 0;
+            for (size_t k = first; k < last; k++) {
+                if (isVoxelStart(k)) starts++;
+            }
+            chunkVoxels[chunk + 1] = starts;
+        });
+        for (size_t c = 0; c < chunks; c++) {
+            chunkVoxels[c + 1] += chunkVoxels[c];
+        }
+        const size_t voxels = chunkVoxels[chunks];
+
+        std::vector<uint32_t> voxelStart(voxels + 1);
+        voxelStart[voxels] = static_cast<uint32_t>(count);
+        ParallelFor(count, VOXEL_MIN_CHUNK, [&](size_t first, size_t last, size_t chunk) {
+            size_t voxel = chunkVoxels[chunk];
+            for (size_t k = first; k < last; k++) {
+                if (isVoxelStart(k)) voxelStart[voxel++] = static_cast<uint32_t>(k);
+            }
+        });
+
+        // reduce every voxel to its representative
+        result.points.Resize(voxels);
+        result.points.m_hasNormals = cloud.m_hasNormals;
+        result.points.m_origin = cloud.m_origin;
+        result.voxelOfPoint.resize(count);
+        ParallelFor(voxels, VOXEL_MIN_CHUNK / 16, [&](size_t first, size_t last, size_t) {
+            for (size_t v = first; v < last; v++) {
+                glm::dvec3 position(0.0);
+                glm::vec3 color(0.0f);
+                glm::vec3 normal(0.0f);
+                int id = -1;
+
+                for (uint32_t k = voxelStart[v]; k < voxelStart[v + 1]; k++) {
+                    uint32_t i = order[k];
+                    position += glm::dvec3(cloud.m_positions[i]);
+                    color += cloud.m_colors[i];
+                    normal += cloud.m_normals[i];
+                    if (id < 0 || (cloud.m_ids[i] >= 0 && cloud.m_ids[i] < id)) id = cloud.m_ids[i];
+                    result.voxelOfPoint[i] = static_cast<uint32_t>(v);
+                }
+
+                double points = double(voxelStart[v + 1] - voxelStart[v]);
+                result.points.m_positions[v] = glm::vec3(position / points);
+                result.points.m_colors[v] = color / float(points);
+                float length = glm::length(normal);
+                result.points.m_normals[v] = (cloud.m_hasNormals && length > 0.0f) ? normal / length : glm::vec3(0.0f);
+                result.points.m_ids[v] = id;
+            }
+        });
+
+        result.points.InvalidateIDIndex();
+        result.points.ComputeBounds();
+        return result;
+    }
+
+    void RemapVoxels(std::vector<uint32_t>& voxelOfPoint, const std::vector<uint32_t>& order) {
+        std::vector<uint32_t> newIndex(order.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            newIndex[order[i]] = static_cast<uint32_t>(i);
+        }
+        ParallelFor(voxelOfPoint.size(), VOXEL_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+            for (size_t i = first; i < last; i++) {
+                voxelOfPoint[i] = newIndex[voxelOfPoint[i]];
+            }
+        });
+    }
+
+    void ScatterNormals(PointCloudView representatives, const std::vector<uint32_t>& voxelOfPoint, PointCloud& cloud) {
+        if (voxelOfPoint.size() != cloud.Size()) {
+            std::cerr << "Voxel map does not belong to this cloud." << std::endl;
+            return;
+        }
+        ParallelFor(cloud.Size(), VOXEL_MIN_CHUNK, [&](size_t first, size_t last, size_t) {
+            for (size_t i = first; i < last; i++) {
+                cloud.m_normals[i] = representatives.m_normals[voxelOfPoint[i]];
+            }
+        });
+    }
+}
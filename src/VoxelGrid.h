@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "PointCloud.h"
+
+// result of VoxelGrid::Downsample
+struct VoxelDownsample {
+    PointCloud points;                      // one representative per occupied voxel
+    std::vector<uint32_t> voxelOfPoint;     // representative index for every point of the source cloud
+};
+
+/*
+ * VoxelGrid
+ *
+ * Optional stage between loading and GPU upload for scans that are far denser
+ * than the screen-space normal pass can resolve. Points are grouped into cubic
+ * voxels (parallel radix sort over 63 bit voxel Morton keys) and every voxel is
+ * replaced by its centroid with averaged color (and normal, if the source has
+ * normals). A representative keeps the smallest original ID of its voxel, so
+ * ground truth lookups by ID keep working.
+ *
+ * voxelOfPoint maps every source point to its representative, ScatterNormals()
+ * copies the computed normals back to the full resolution cloud.
+ */
+namespace VoxelGrid {
+
+    VoxelDownsample Downsample(PointCloudView cloud, float voxelSize);
+
+    // keeps voxelOfPoint valid after the representatives were reordered with order (see PointCloud::Reorder)
+    void RemapVoxels(std::vector<uint32_t>& voxelOfPoint, const std::vector<uint32_t>& order);
+
+    // cloud.m_normals[i] = representatives.m_normals[voxelOfPoint[i]]
+    void ScatterNormals(PointCloudView representatives, const std::vector<uint32_t>& voxelOfPoint, PointCloud& cloud);
+}
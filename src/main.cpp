@@ -1,10 +1,170 @@
 #include "App.h"
+#include "NormalEstimation.h"
+#include "PLY_stream.h"
+#include "Parallel.h"
+#include "ScreenSpaceNormals.h"
+#include "SpatialOrder.h"
+#include "ViewPlanner.h"
 
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+
+// depth_normals --cpu-normals <input> <output.ply> [neighbours]
+// estimates the normals on the CPU without opening a window, for machines without a GPU
+static int RunCpuNormals(int argc, char** argv) {
+	if (argc < 4) {
+		std::cerr << "Usage: " << argv[0] << " --cpu-normals <input> <output.ply> [neighbours]" << std::endl;
+		return 1;
+	}
+
+	PLY_loader loader;
+	PointCloud cloud = PointCache::Load(argv[2], loader);
+	if (cloud.Size() == 0) {
+		std::cerr << "No points loaded from " << argv[2] << std::endl;
+		return 1;
+	}
+
+	// neighbour queries are much faster on a spatially coherent order, SavePLY restores the ID order
+	SpatialOrder::SortMorton(cloud);
+
+	PCANormalOptions options;
+	if (argc > 4) {
+		options.neighbours = std::atoi(argv[4]);
+	}
+	EstimateNormalsPCA(cloud, options);
+
+	if (!loader.SavePLY(argv[3], cloud)) {
+		return 1;
+	}
+	std::cout << "Exported ply file! \n";
+	return 0;
+}
+
+// normals of the file at path for the points of cloud, looked up by ID. PLY files (by extension) are streamed in
+// batches, so only the normals are held next to the cloud instead of a second full cloud; other formats are loaded
+static PointVector<glm::vec4> LoadNormalsByID(const std::string& path, const PointCloud& cloud, PLY_loader& loader) {
+	if (PLY_loader::DetectFormat(path, "", 0) != PointFileFormat::PLY) {
+		return PointCache::Load(path, loader).PackNormalsByID(cloud.m_ids.data(), cloud.Size());
+	}
+
+	PointVector<glm::vec4> normals(cloud.Size(), glm::vec4(0.0f));
+	PLY_stream stream;
+	if (!stream.Open(path)) {
+		return normals;
+	}
+
+	size_t matched = 0;
+	stream.ForEachBatch([&](const PointBatch& batch) {
+		const PointCloud& points = batch.points;
+		std::vector<size_t> chunkMatched(ChunkCount(points.Size(), 1 << 16), 0);
+		ParallelFor(points.Size(), 1 << 16, [&](size_t first, size_t last, size_t chunk) {
+			for (size_t i = first; i < last; i++) {
+				int index = cloud.FindIndexByID(points.m_ids[i]);
+				if (index < 0) continue;
+				normals[index] = glm::vec4(points.m_normals[i], 0.0f);
+				chunkMatched[chunk]++;
+			}
+		});
+		for (size_t count : chunkMatched) matched += count;
+		return true;
+	});
+
+	if (!stream.HasNormals()) {
+		std::cerr << "Ground truth without normals: " << path << std::endl;
+	}
+	std::cout << "Ground truth: " << matched << " of " << cloud.Size() << " points matched by ID" << std::endl;
+	return normals;
+}
+
+// depth_normals --screen-space <input> <output.ply> [splatSize] [--layered] [--plan]
+// the screen space method of Renderer::Render on the CPU, same camera, views and target size as the window:
+// the orbit around the start camera, --plan for the views of ViewPlanner like m_planViews. Like the default per-view
+// loop the last view a point is visible in decides, --layered averages over all views like m_layeredViews
+static int RunScreenSpace(int argc, char** argv) {
+	if (argc < 4) {
+		std::cerr << "Usage: " << argv[0] << " --screen-space <input> <output.ply> [splatSize] [--layered] [--plan]" << std::endl;
+		return 1;
+	}
+
+	PLY_loader loader;
+	PointCloud cloud = PointCache::Load(argv[2], loader);
+	if (cloud.Size() == 0) {
+		std::cerr << "No points loaded from " << argv[2] << std::endl;
+		return 1;
+	}
+
+	SpatialOrder::SortMorton(cloud);
+
+	// ground truth like Renderer::Start: the file in the ground_truth folder, else the normals of the input
+	std::string pathGT = argv[2];
+	size_t pos = pathGT.find("no_normals");
+	PointVector<glm::vec4> normalsGT;
+	if (pos != std::string::npos) {
+		pathGT.replace(pos, std::strlen("no_normals"), "ground_truth");
+		normalsGT = LoadNormalsByID(pathGT, cloud, loader);
+	}
+	else {
+		normalsGT = cloud.PackNormalsByID(cloud.m_ids.data(), cloud.Size());
+	}
+	cloud.m_hasNormals = false;
+
+	const int width = 1920, height = 1080;
+	Camera camera(glm::vec3(0.0f, 0.0f, 6.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(camera.m_zoom), float(width) / float(height), 0.1f, 100.0f);
+	float splatSize = 3.0f;
+	bool layered = false;
+	bool plan = false;
+	for (int i = 4; i < argc; i++) {
+		if (std::strcmp(argv[i], "--layered") == 0) layered = true;
+		else if (std::strcmp(argv[i], "--plan") == 0) plan = true;
+		else splatSize = float(std::atof(argv[i]));
+	}
+
+	std::vector<glm::mat4> views = ScreenSpaceNormals::OrbitViews(camera.GetViewMatrix());
+	if (plan) {
+		ViewPlanOptions options;
+		options.width = width;
+		options.height = height;
+		options.fovY = glm::radians(camera.m_zoom);
+		options.splatSize = splatSize;
+		ViewPlan viewPlan = ViewPlanner().Plan(cloud, options);
+		views = viewPlan.views;
+		projection = viewPlan.projection;
+	}
+
+	ScreenSpaceNormals normals;
+	auto begin = std::chrono::steady_clock::now();
+	if (layered) {
+		normals.ComputeViews(cloud, normalsGT.data(), glm::mat4(1.0f), views, projection, splatSize, width, height);
+	}
+	else {
+		for (const glm::mat4& view : views) {
+			normals.ComputeView(cloud, normalsGT.data(), glm::mat4(1.0f), view, projection, splatSize, width, height);
+		}
+	}
+	std::cout << "All views: " << MillisecondsSince(begin) << " ms" << std::endl;
+	cloud.m_hasNormals = true;
+
+	if (!loader.SavePLY(argv[3], cloud)) {
+		return 1;
+	}
+	std::cout << "Exported ply file! \n";
+	return 0;
+}
+
+int main(int argc, char** argv) {
+
+	if (argc > 1 && std::strcmp(argv[1], "--cpu-normals") == 0) {
+		return RunCpuNormals(argc, argv);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--screen-space") == 0) {
+		return RunScreenSpace(argc, argv);
+	}
 
-int main() {
-	
 	App app(1920,1080);
 	app.run();
 	return 0;
 }
-
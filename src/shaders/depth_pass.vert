@@ -3,8 +3,13 @@
 layout (location = 0) in int ID;
 layout (location = 1) in vec3 position;
 
-uniform mat4 view;
-uniform mat4 proj;
+layout(std140, binding = 0) uniform ViewBlock {
+    mat4 view;
+    mat4 proj;
+    mat4 invView;
+    mat4 invProj;
+};
+
 uniform mat4 model;
 
 uniform float pointSize;
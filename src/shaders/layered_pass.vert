@@ -0,0 +1,31 @@
+#version 450 core
+#extension GL_ARB_shader_viewport_layer_array : require
+
+// depth_pass.vert / biggerSplat_pass.vert for all views at once: instance i draws into layer i
+
+layout (location = 0) in int ID;
+layout (location = 1) in vec3 position;
+
+const int MAX_VIEWS = 8;
+
+struct ViewUniforms {
+    mat4 view;
+    mat4 proj;
+    mat4 invView;
+    mat4 invProj;
+};
+
+layout(std140, binding = 0) uniform ViewBlock { ViewUniforms views[MAX_VIEWS]; };
+uniform mat4 model;
+
+uniform float pointSize;
+
+flat out int vertex_id;
+
+void main()
+{
+    vertex_id = ID;
+    gl_Layer = gl_InstanceID;
+    gl_Position = views[gl_InstanceID].proj * views[gl_InstanceID].view * model * vec4(position, 1.0);
+    gl_PointSize = pointSize;
+}
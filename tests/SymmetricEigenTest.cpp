@@ -0,0 +1,273 @@
+#include "SymmetricEigen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * SymmetricEigenTest
+ *
+ * Compares SymmetricEigen::Solve with a double precision cyclic Jacobi that
+ * runs until the off-diagonal entries vanish. Eigenvalues have to match within
+ * a tolerance relative to the largest entry of the matrix. The eigenvector has
+ * to match the reference where the smallest eigenvalue is separated and has to
+ * be a unit vector of its eigenspace everywhere else. Returns non-zero on
+ * failure.
+ */
+namespace {
+
+    const float VALUE_TOLERANCE = 2e-5f;        // relative to the largest entry
+    const float RESIDUAL_TOLERANCE = 1e-4f;     // |A v - value0 v|, relative to the largest entry
+    const float UNIT_TOLERANCE = 1e-4f;
+    const double SEPARATED_GAP = 1e-2;          // relative gap above which the eigenvector is unique enough to compare
+
+    struct TestMatrix {
+        std::string name;
+        float entries[6];   // xx, xy, xz, yy, yz, zz
+    };
+
+    struct Reference {
+        double values[3];   // ascending
+        double vectors[3][3];   // vectors[k] belongs to values[k]
+    };
+
+    Reference SolveReference(const float entries[6]) {
+        double a[3][3] = {
+            { entries[0], entries[1], entries[2] },
+            { entries[1], entries[3], entries[4] },
+            { entries[2], entries[4], entries[5] }
+        };
+        double v[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+
+        for (int sweep = 0; sweep < 100; sweep++) {
+            double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+            if (off < 1e-300) break;
+
+            for (int p = 0; p < 2; p++) {
+                for (int q = p + 1; q < 3; q++) {
+                    if (a[p][q] == 0.0) continue;
+                    double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                    double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                    double c = 1.0 / std::sqrt(t * t + 1.0);
+                    double s = t * c;
+
+                    for (int k = 0; k < 3; k++) {
+                        double akp = a[k][p], akq = a[k][q];
+                        a[k][p] = c * akp - s * akq;
+                        a[k][q] = s * akp + c * akq;
+                    }
+                    for (int k = 0; k < 3; k++) {
+                        double apk = a[p][k], aqk = a[q][k];
+                        a[p][k] = c * apk - s * aqk;
+                        a[q][k] = s * apk + c * aqk;
+                    }
+                    for (int k = 0; k < 3; k++) {
+                        double vkp = v[k][p], vkq = v[k][q];
+                        v[k][p] = c * vkp - s * vkq;
+                        v[k][q] = s * vkp + c * vkq;
+                    }
+                }
+            }
+        }
+
+        int order[3] = { 0, 1, 2 };
+        std::sort(order, order + 3, [&](int l, int r) { return a[l][l] < a[r][r]; });
+
+        Reference reference;
+        for (int k = 0; k < 3; k++) {
+            reference.values[k] = a[order[k]][order[k]];
+            for (int axis = 0; axis < 3; axis++) reference.vectors[k][axis] = v[axis][order[k]];
+        }
+        return reference;
+    }
+
+    // rotation * diag(values) * rotation^T with a random rotation
+    TestMatrix Rotated(const std::string& name, double l0, double l1, double l2, std::mt19937& random) {
+        std::normal_distribution<double> normal;
+        double q[4] = { normal(random), normal(random), normal(random), normal(random) };
+        double length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        double w = q[0] / length, x = q[1] / length, y = q[2] / length, z = q[3] / length;
+        double r[3][3] = {
+            { 1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y) },
+            { 2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x) },
+            { 2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y) }
+        };
+        const double l[3] = { l0, l1, l2 };
+        auto entry = [&](int i, int j) {
+            double sum = 0.0;
+            for (int k = 0; k < 3; k++) sum += r[i][k] * l[k] * r[j][k];
+            return static_cast<float>(sum);
+        };
+        return { name, { entry(0, 0), entry(0, 1), entry(0, 2), entry(1, 1), entry(1, 2), entry(2, 2) } };
+    }
+
+    // covariance of a neighbourhood through NeighbourhoodCovariance, like the normal estimation builds it
+    TestMatrix Neighbourhood(const std::string& name, const std::vector<glm::vec3>& positions) {
+        std::vector<uint32_t> neighbours;
+        for (uint32_t n = 1; n < positions.size(); n++) neighbours.push_back(n);
+
+        SymmetricEigen::SymmetricMatrices matrices;
+        matrices.Resize(1);
+        SymmetricEigen::NeighbourhoodCovariance(positions.data(), 0, neighbours.data(), neighbours.size(), matrices, 0);
+        return { name, { matrices.xx[0], matrices.xy[0], matrices.xz[0], matrices.yy[0], matrices.yz[0], matrices.zz[0] } };
+    }
+
+    std::vector<TestMatrix> BuildMatrices() {
+        std::mt19937 random(12345);
+        std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+        std::vector<TestMatrix> matrices;
+
+        // random symmetric matrices (indefinite) and random covariances over many magnitudes
+        for (int m = 0; m < 200; m++) {
+            float magnitude = std::pow(10.0f, float(m % 13) - 6.0f);
+            TestMatrix matrix = { "random", {} };
+            for (float& entry : matrix.entries) entry = uniform(random) * magnitude;
+            matrices.push_back(matrix);
+
+            std::vector<glm::vec3> positions(16);
+            for (glm::vec3& p : positions) p = glm::vec3(uniform(random), uniform(random), uniform(random)) * magnitude;
+            matrices.push_back(Neighbourhood("random covariance", positions));
+        }
+
+        // noisy planes and lines in random orientations, far away from the origin as well
+        for (int m = 0; m < 100; m++) {
+            glm::vec3 offset = (m % 2) ? glm::vec3(5000.0f, -3000.0f, 200.0f) : glm::vec3(0.0f);
+            glm::vec3 u = glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)));
+            glm::vec3 helper = std::abs(u.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::vec3 v = glm::normalize(glm::cross(u, helper));
+            glm::vec3 n = glm::cross(u, v);
+            float noise = (m % 3 == 0) ? 0.0f : 1e-3f;
+
+            std::vector<glm::vec3> plane(20), line(20);
+            for (size_t i = 0; i < plane.size(); i++) {
+                plane[i] = offset + u * uniform(random) + v * uniform(random) + n * (uniform(random) * noise);
+                line[i] = offset + u * uniform(random) + (v * uniform(random) + n * uniform(random)) * noise;
+            }
+            matrices.push_back(Neighbourhood("planar", plane));
+            matrices.push_back(Neighbourhood("linear", line));
+        }
+
+        // repeated eigenvalues: double smallest, double largest, all equal, and exactly diagonal
+        for (int m = 0; m < 50; m++) {
+            matrices.push_back(Rotated("repeated smallest", 1.0, 1.0, 2.0, random));
+            matrices.push_back(Rotated("repeated largest", 0.5, 3.0, 3.0, random));
+            matrices.push_back(Rotated("repeated zero", 0.0, 0.0, 1.0, random));
+            matrices.push_back(Rotated("all equal", 2.0, 2.0, 2.0, random));
+        }
+        matrices.push_back({ "diagonal", { 3.0f, 0.0f, 0.0f, 1.0f, 0.0f, 2.0f } });
+        matrices.push_back({ "identity", { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f } });
+
+        matrices.push_back({ "zero", { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f } });
+        return matrices;
+    }
+
+    // checks the first count results, returns the number of failures
+    int Check(const std::vector<TestMatrix>& matrices, const SymmetricEigen::SmallestEigen& result, size_t count, const std::string& run) {
+        int failures = 0;
+        for (size_t i = 0; i < count; i++) {
+            const TestMatrix& matrix = matrices[i];
+            const float* e = matrix.entries;
+            float scale = 0.0f;
+            for (float entry : matrix.entries) scale = std::max(scale, std::abs(entry));
+
+            const double values[3] = { result.value0[i], result.value1[i], result.value2[i] };
+            const double vector[3] = { result.x[i], result.y[i], result.z[i] };
+            std::string error;
+
+            if (scale == 0.0f) {
+                // documented result of a zero matrix
+                if (values[0] != 0.0 || values[1] != 0.0 || values[2] != 0.0 || vector[0] != 1.0 || vector[1] != 0.0 || vector[2] != 0.0) {
+                    error = "zero matrix needs zero eigenvalues and the x axis";
+                }
+            }
+            else {
+                Reference reference = SolveReference(e);
+                for (int k = 0; k < 3; k++) {
+                    if (!(std::abs(values[k] - reference.values[k]) <= VALUE_TOLERANCE * scale)) {
+                        error = "eigenvalue " + std::to_string(k) + " is " + std::to_string(values[k]) + ", expected " + std::to_string(reference.values[k]);
+                    }
+                }
+
+                double length = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+                const double a[3][3] = { { e[0], e[1], e[2] }, { e[1], e[3], e[4] }, { e[2], e[4], e[5] } };
+                double residual = 0.0;
+                for (int row = 0; row < 3; row++) {
+                    double r = a[row][0] * vector[0] + a[row][1] * vector[1] + a[row][2] * vector[2] - reference.values[0] * vector[row];
+                    residual += r * r;
+                }
+                residual = std::sqrt(residual);
+
+                if (!(std::abs(length - 1.0) <= UNIT_TOLERANCE)) {
+                    error = "eigenvector length " + std::to_string(length);
+                }
+                else if (!(residual <= RESIDUAL_TOLERANCE * scale)) {
+                    error = "eigenvector residual " + std::to_string(residual / scale);
+                }
+                else if (reference.values[1] - reference.values[0] > SEPARATED_GAP * scale) {
+                    const double* expected = reference.vectors[0];
+                    double dot = std::abs(vector[0] * expected[0] + vector[1] * expected[1] + vector[2] * expected[2]);
+                    if (!(dot >= 1.0 - RESIDUAL_TOLERANCE)) {
+                        error = "eigenvector off by |dot| " + std::to_string(dot);
+                    }
+                }
+            }
+
+            if (!error.empty()) {
+                std::cerr << run << ", matrix " << i << " (" << matrix.name << "): " << error << std::endl;
+                failures++;
+            }
+        }
+        return failures;
+    }
+
+    int SolveAndCheck(const std::vector<TestMatrix>& matrices, size_t count, const std::string& run) {
+        SymmetricEigen::SymmetricMatrices input;
+        input.Resize(count);
+        for (size_t i = 0; i < count; i++) {
+            const float* e = matrices[i].entries;
+            input.xx[i] = e[0]; input.xy[i] = e[1]; input.xz[i] = e[2];
+            input.yy[i] = e[3]; input.yz[i] = e[4]; input.zz[i] = e[5];
+        }
+
+        SymmetricEigen::SmallestEigen result;
+        SymmetricEigen::Solve(input, result);
+        if (result.Size() != count) {
+            std::cerr << run << ": " << result.Size() << " results for " << count << " matrices" << std::endl;
+            return 1;
+        }
+        return Check(matrices, result, count, run);
+    }
+}
+
+int main() {
+    std::vector<TestMatrix> matrices = BuildMatrices();
+    const size_t batch = SymmetricEigen::BatchWidth();
+    std::cout << "SymmetricEigen: " << SymmetricEigen::InstructionSet() << ", batch width " << batch << std::endl;
+
+    // every count but the full set ends in a tail batch (count % batch != 0)
+    std::vector<std::pair<std::string, size_t>> runs = { { "all matrices", matrices.size() } };
+    for (size_t count : { size_t(1), batch - 1, batch + 1, 3 * batch + 5 }) {
+        if (count > 0 && count < matrices.size()) runs.push_back({ std::to_string(count) + " matrices", count });
+    }
+
+    int failures = 0;
+    for (const auto& run : runs) {
+        failures += SolveAndCheck(matrices, run.second, run.first);
+    }
+
+    // the tail batch pads with zero matrices, they must not leak into real slots
+    std::vector<TestMatrix> zeroTail(matrices.end() - 1, matrices.end());
+    zeroTail.insert(zeroTail.begin(), matrices.begin(), matrices.begin() + (batch + 2));
+    failures += SolveAndCheck(zeroTail, zeroTail.size(), "zero in the tail");
+
+    if (failures > 0) {
+        std::cerr << failures << " of the checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed (" << matrices.size() << " matrices)" << std::endl;
+    return 0;
+}